@@ -1,20 +1,225 @@
 #include "App.h"
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <mutex>
+#include <algorithm>
 #include <functional>
+#include <set>
 #include <unordered_map>
+#include "Http2.h"
+#include "HttpDate.h"
+
+namespace
+{
+    constexpr size_t FS_POOL_SIZE = 4;
+
+    /* Distinct (package, core) pairs; SMT siblings would only fight over the same ALUs */
+    size_t physicalCoreCount()
+    {
+        std::set<std::pair<int, int>> cores;
+        for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+        {
+            std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            std::ifstream package(topology + "physical_package_id");
+            std::ifstream core(topology + "core_id");
+            int packageId = 0;
+            int coreId = 0;
+            if (!(package >> packageId) || !(core >> coreId))
+            {
+                return std::max(1u, std::thread::hardware_concurrency());
+            }
+            cores.emplace(packageId, coreId);
+        }
+        return std::max<size_t>(1, cores.size());
+    }
+
+    bool endsWithIgnoreCase(std::string_view str, std::string_view suffix)
+    {
+        return str.size() >= suffix.size() && equalsIgnoreCase(str.substr(str.size() - suffix.size()), suffix);
+    }
+
+    bool wantsKeepAlive(const Request& req)
+    {
+        std::string_view connection = req.getHeader(HeaderId::Connection);
+        if (req.version == "HTTP/1.0")
+        {
+            return equalsIgnoreCase(connection, "keep-alive");
+        }
+        return !equalsIgnoreCase(connection, "close");
+    }
+
+    /* Connection header a response needs besides what HTTP/1.1 implies */
+    std::string_view connectionField(const Exchange* exchange)
+    {
+        if (!exchange->keepAlive)
+        {
+            return "Connection: close\r\n";
+        }
+        return exchange->req.version == "HTTP/1.0" ? "Connection: keep-alive\r\n" : "";
+    }
+
+    /* Bodies up to this size are copied behind the head; larger ones are written from where they are kept */
+    constexpr size_t INLINE_BODY_SIZE = 1024;
+
+    /* A HEAD response carries the GET response's head, Content-Length included, and nothing after it */
+    bool omitsBody(const Exchange* exchange)
+    {
+        return exchange->req.method == "HEAD";
+    }
+
+    /* Head of a shared response plus the Connection field into `wire`; the body is kept by reference unless it is small */
+    void writeShared(Exchange* exchange, const SharedResponse& response)
+    {
+        std::string_view bytes = response.wire->view();
+        std::string_view connection = connectionField(exchange);
+        size_t bodyStart = response.headEnd + 2;
+        bool copyBody = bytes.size() - bodyStart <= INLINE_BODY_SIZE;
+        exchange->wire.reserve(bodyStart + connection.size() + (copyBody ? bytes.size() - bodyStart : 0));
+        exchange->wire.append(bytes.substr(0, response.headEnd));
+        exchange->wire.append(connection);
+        exchange->wire.append("\r\n");
+        if (omitsBody(exchange))
+        {
+            return;
+        }
+        if (copyBody)
+        {
+            exchange->wire.append(bytes.substr(bodyStart));
+            return;
+        }
+        exchange->res.send(response.wire, bodyStart);
+        exchange->wireBody = exchange->res.content();
+    }
+
+    /* GET and HEAD, the only methods a constant or shared response answers */
+    bool readsOnly(const Request& req)
+    {
+        return req.method == "GET" || req.method == "HEAD";
+    }
+
+    /* Whether a body follows the head, going by its framing headers */
+    bool hasBody(const Request& req)
+    {
+        std::string_view contentLength = req.getHeader(HeaderId::ContentLength);
+        return !req.getHeader(HeaderId::TransferEncoding).empty() || (!contentLength.empty() && contentLength != "0");
+    }
+
+    bool containsIgnoreCase(std::string_view str, std::string_view token)
+    {
+        for (size_t i = 0; i + token.size() <= str.size(); ++i)
+        {
+            if (equalsIgnoreCase(str.substr(i, token.size()), token))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Only what any client may be given: nothing per-user and nothing the handler keeps private */
+    bool isShareable(const Response& res)
+    {
+        std::string_view cacheControl = res.headers.get("Cache-Control");
+        return !res.eventStream && !res.headers.has("Set-Cookie")
+            && !containsIgnoreCase(cacheControl, "no-store") && !containsIgnoreCase(cacheControl, "private");
+    }
+
+    bool isWebSocketUpgrade(const Request& req)
+    {
+        return req.method == "GET" && req.version == "HTTP/1.1"
+            && containsIgnoreCase(req.getHeader(HeaderId::Upgrade), "websocket")
+            && containsIgnoreCase(req.getHeader(HeaderId::Connection), "upgrade")
+            && req.getHeader(HeaderId::SecWebSocketVersion) == "13"
+            && !req.getHeader(HeaderId::SecWebSocketKey).empty()
+            && req.getHeader(HeaderId::TransferEncoding).empty();
+    }
+
+    /* Whether the comma-separated `list` has `token` as one of its elements */
+    bool hasToken(std::string_view list, std::string_view token)
+    {
+        while (!list.empty())
+        {
+            size_t comma = list.find(',');
+            std::string_view element = list.substr(0, comma);
+            size_t first = element.find_first_not_of(" \t");
+            size_t last = element.find_last_not_of(" \t");
+            if (first != std::string_view::npos && equalsIgnoreCase(element.substr(first, last - first + 1), token))
+            {
+                return true;
+            }
+            if (comma == std::string_view::npos)
+            {
+                break;
+            }
+            list.remove_prefix(comma + 1);
+        }
+        return false;
+    }
+
+    /* h2c upgrade of a bodiless request (RFC 7540 section 3.2); anything else stays on HTTP/1.1 */
+    bool wantsHttp2Upgrade(const Request& req)
+    {
+        std::string_view connection = req.getHeader(HeaderId::Connection);
+        return req.version == "HTTP/1.1" && hasToken(req.getHeader(HeaderId::Upgrade), "h2c")
+            && hasToken(connection, "Upgrade") && hasToken(connection, "HTTP2-Settings")
+            && req.headers.has(HeaderId::Http2Settings)
+            && req.getHeader(HeaderId::TransferEncoding).empty()
+            && (req.getHeader(HeaderId::ContentLength).empty() || req.getHeader(HeaderId::ContentLength) == "0");
+    }
+
+    constexpr std::string_view BAD_REQUEST =
+        "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    constexpr std::string_view PAYLOAD_TOO_LARGE =
+        "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    constexpr std::string_view EXPECTATION_FAILED =
+        "HTTP/1.1 417 Expectation Failed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    constexpr std::string_view URI_TOO_LONG =
+        "HTTP/1.1 414 URI Too Long\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    constexpr std::string_view HEADERS_TOO_LARGE =
+        "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    constexpr std::string_view VERSION_NOT_SUPPORTED =
+        "HTTP/1.1 505 HTTP Version Not Supported\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    std::string_view rejectionFor(HeadParser::Status status)
+    {
+        switch (status)
+        {
+            case HeadParser::Status::UriTooLong: return URI_TOO_LONG;
+            case HeadParser::Status::HeadersTooLarge: return HEADERS_TOO_LARGE;
+            case HeadParser::Status::VersionNotSupported: return VERSION_NOT_SUPPORTED;
+            default: return BAD_REQUEST;
+        }
+    }
+
+    constexpr std::string_view CONTINUE = "HTTP/1.1 100 Continue\r\n\r\n";
+    constexpr std::string_view SWITCHING_TO_WEBSOCKET =
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+    constexpr std::string_view SWITCHING_TO_H2C =
+        "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+
+    /* Largest piece of a streamed body handed to one req.read() */
+    constexpr size_t STREAM_CHUNK_SIZE = 16 * 1024;
+}
 
 App::App() 
-    : threadPool(2 * std::thread::hardware_concurrency()), serverSocket(-1)
+    : threadPool(2 * std::thread::hardware_concurrency()), fsPool(FS_POOL_SIZE), computePool(physicalCoreCount()),
+      serverSocket(-1)
 {
     /* Initialize ThreadPool with double the hardware thread count */
 }
 
 App::App(size_t ThreadCount)
-    : threadPool(ThreadCount), serverSocket(-1)
+    : threadPool(ThreadCount), fsPool(FS_POOL_SIZE), computePool(physicalCoreCount()), serverSocket(-1)
 {
 }
 
@@ -34,6 +239,8 @@ App::listen(int port, std::function<void()> onStart)
         return;
     }
 
+    loop.start();
+
     if (onStart)
     {
         onStart();
@@ -41,12 +248,16 @@ App::listen(int port, std::function<void()> onStart)
 
     while (true)
     {
-        int clientSocket = accept(serverSocket, nullptr, nullptr);
+        int clientSocket = accept4(serverSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (clientSocket >= 0)
         {
-            threadPool.enqueue([this, clientSocket] 
+            int noDelay = 1;
+            setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            /* The connection lives on the event loop from here on */
+            loop.post([this, clientSocket]
             {
-                handleRequest(clientSocket);
+                openConnection(clientSocket);
             });
         }
     }
@@ -55,55 +266,1543 @@ App::listen(int port, std::function<void()> onStart)
 }
 
 void
-App::get(const std::string& path, RouteHandler handler)
+App::ws(const std::string& path, Route::WebSocketHandler handler, RouteOptions options)
 {
-    std::lock_guard<std::mutex> lock(routesMutex);
-    routes[path] = handler;
+    Route route;
+    route.webSocketHandler = std::move(handler);
+    route.options = options;
+    addRoute(path, std::move(route));
+}
+
+Channel&
+App::channel(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(channelsMutex);
+    std::unique_ptr<Channel>& channel = channels[name];
+    if (!channel)
+    {
+        channel = std::make_unique<Channel>(name, limits.maxWebSocketBackpressure,
+            [this](std::function<void()> task)
+            {
+                loop.post(std::move(task));
+            },
+            [this](Connection* connection)
+            {
+                if (!connection->broken && !connection->flush())
+                {
+                    connection->broken = true;
+                }
+                updateInterest(connection);
+            });
+    }
+    return *channel;
+}
+
+void
+App::getStatic(const std::string& path, std::string_view body, std::string_view contentType, RouteOptions options)
+{
+    Response res;
+    res.setHeader("Date", std::string(HttpDateLength, ' '));
+    res.setHeader("Content-Type", contentType);
+    res.body = body;
+    std::pmr::string wire;
+    res.serialize(wire, &defaultHeaders);
+
+    Route route;
+    route.options = options;
+    route.prebuilt = SharedResponse::make(std::string(wire));
+    route.dateOffset = route.prebuilt.wire->view().find("\r\nDate: ") + 8;
+    addRoute(path, std::move(route));
 }
 
 void
-App::post(const std::string& path, RouteHandler handler)
+App::addRoute(const std::string& path, Route route)
+{
+    if (route.options.cache.ttl.count() > 0)
+    {
+        route.cache = std::make_shared<ResponseCache>(route.options.cache);
+    }
+    if (route.options.singleFlight)
+    {
+        route.flights = std::make_shared<SingleFlight>();
+    }
+    std::lock_guard<std::mutex> lock(routesMutex);
+    routes[path] = std::make_shared<const Route>(std::move(route));
+}
+
+std::shared_ptr<const Route>
+App::findRoute(std::string_view path)
 {
     std::lock_guard<std::mutex> lock(routesMutex);
-    routes[path] = handler;
+    auto it = routes.find(path);
+    return it != routes.end() ? it->second : nullptr;
+}
+
+ThreadPool::LaneStats
+App::queueStats(Priority priority) const
+{
+    return threadPool.laneStats(priority);
+}
+
+void
+App::setSpinPolicy(const ThreadPool::SpinPolicy& policy)
+{
+    threadPool.setSpinPolicy(policy);
+}
+
+void
+App::use(Filter filter)
+{
+    filters.push_back(std::move(filter));
+}
+
+void
+App::setDefaultHeader(std::string_view name, std::string_view value)
+{
+    defaultHeaders.set(name, value);
+}
+
+void
+App::enableCompression(const CompressionOptions& options)
+{
+    compression = options;
+}
+
+void
+App::setLimits(const ServerLimits& serverLimits)
+{
+    limits = serverLimits;
 }
 
 void
-App::handleRequest(int clientSocket)
+App::openConnection(int clientSocket)
 {
-    constexpr uint16_t BUFFER_SIZE = 1024;
-    char buffer[BUFFER_SIZE] = {0};
-    ssize_t bytesRead = read(clientSocket, buffer, BUFFER_SIZE);
+    auto connection = std::make_unique<Connection>(clientSocket);
+    Connection* raw = connection.get();
+    connections[clientSocket] = std::move(connection);
+
+    raw->interest = EPOLLIN;
+    loop.add(clientSocket, EPOLLIN, [this, raw](uint32_t events)
+    {
+        onConnectionEvent(raw, events);
+    });
+}
 
-    if (bytesRead < 0)
+void
+App::onConnectionEvent(Connection* connection, uint32_t events)
+{
+    /* Zero-copy completions are signalled as an error too */
+    if ((events & EPOLLERR) && !(events & EPOLLHUP) && connection->reapZeroCopy())
     {
-        std::cerr << "Read failed\n";
-        close(clientSocket);
+        events &= ~EPOLLERR;
+    }
+    if (events & (EPOLLHUP | EPOLLERR))
+    {
+        /* Both directions are gone; nothing more can be read or written */
+        connection->peerClosed = true;
+        connection->broken = true;
+        updateInterest(connection);
         return;
     }
 
-    std::string requestStr(buffer);
-    Request req(requestStr);
-    
-    Response res;
-    res.statusCode = 404; // Default to 404 Not Found
+    if ((events & EPOLLOUT) && !connection->flush())
+    {
+        connection->broken = true;
+    }
+
+    if (events & EPOLLIN)
+    {
+        connection->readAvailable(limits.maxRequestSize);
+    }
+
+    /* Input may also be waiting on the pipelining limit that a finished write just lifted */
+    if (!connection->broken)
+    {
+        parseRequests(connection);
+    }
+    updateInterest(connection);
+}
+
+void
+App::parseRequests(Connection* connection)
+{
+    if (connection->http2)
+    {
+        receiveHttp2(connection);
+        return;
+    }
+    if (connection->webSocket && connection->webSocket->connection)
+    {
+        receiveWebSocket(connection);
+        return;
+    }
+    if (connection->eventStream)
+    {
+        /* Read only to notice the peer going away */
+        connection->consume(connection->unparsed().size());
+        connection->releaseInput();
+        return;
+    }
+
+    bool answered = false;
+    while (true)
+    {
+        if (connection->reading)
+        {
+            if (!feedBody(connection))
+            {
+                break;
+            }
+            continue;
+        }
+
+        /* After a WebSocket handshake the rest of the input is frames, not requests */
+        if (connection->closeAfterWrite || connection->webSocket || connection->inFlight >= limits.maxPipelineDepth)
+        {
+            break;
+        }
+
+        std::string_view input = connection->unparsed();
+        if (input.empty())
+        {
+            break;
+        }
+
+        /* HTTP/2 with prior knowledge starts with its preface instead of a request */
+        if (connection->inFlight == 0 && Http2Session::Preface.starts_with(input.substr(0, Http2Session::Preface.size())))
+        {
+            if (input.size() < Http2Session::Preface.size())
+            {
+                break;
+            }
+            startHttp2(connection, nullptr);
+            receiveHttp2(connection);
+            return;
+        }
+
+        HeadParser& parser = connection->headParser;
+        HeadParser::Status status = parser.parse(input, HeadLimits{limits.maxHeaderSize, limits.maxUriLength, limits.maxHeaderCount});
+        if (status == HeadParser::Status::Incomplete)
+        {
+            break;
+        }
+        if (status != HeadParser::Status::Complete)
+        {
+            reject(connection, rejectionFor(status));
+            break;
+        }
+
+        Exchange* exchange = Exchange::create(parser.head());
+        connection->consume(parser.length());
+        parser.reset();
+
+        /* Exactly one Host (RFC 9112 section 3.2); repeated fields arrive comma-joined, which no host name contains */
+        bool missingHost = exchange->req.version == "HTTP/1.1" && !exchange->req.headers.has(HeaderId::Host);
+        if (missingHost || exchange->req.getHeader(HeaderId::Host).find(',') != std::string_view::npos)
+        {
+            exchange->release();
+            reject(connection, BAD_REQUEST);
+            break;
+        }
+
+        exchange->connection = connection;
+        exchange->route = findRoute(exchange->req.path);
+        exchange->keepAlive = wantsKeepAlive(exchange->req);
+        if (!exchange->keepAlive)
+        {
+            connection->closeAfterWrite = true;
+        }
+        ++connection->inFlight;
+
+        /* HTTP/1.0 clients can't expect anything, and 100-continue is the only expectation there is */
+        std::string_view expect = exchange->req.getHeader(HeaderId::Expect);
+        if (exchange->req.version == "HTTP/1.1" && !expect.empty())
+        {
+            if (!equalsIgnoreCase(expect, "100-continue"))
+            {
+                --connection->inFlight;
+                exchange->release();
+                reject(connection, EXPECTATION_FAILED);
+                break;
+            }
+            exchange->awaitingContinue = hasBody(exchange->req);
+        }
+
+        /* Decided on the head alone, so a client waiting for 100 Continue never sends the body */
+        int refusal = screen(exchange->req);
+        if (refusal == 0 && !exchange->route && exchange->awaitingContinue)
+        {
+            refusal = 404;
+        }
+        if (refusal != 0)
+        {
+            refuse(connection, exchange, refusal);
+            continue;
+        }
+
+        if (exchange->route && exchange->route->webSocketHandler && isWebSocketUpgrade(exchange->req))
+        {
+            /* Answered in order with the rest of the batch, then the connection switches over */
+            exchange->webSocket = makeWebSocket(exchange->route->options.priority);
+            connection->webSocket = exchange->webSocket;
+            startBody(connection, exchange);
+            continue;
+        }
+
+        if (connection->inFlight == 1 && wantsHttp2Upgrade(exchange->req))
+        {
+            if (startHttp2(connection, exchange))
+            {
+                receiveHttp2(connection);
+                return;
+            }
+        }
 
+        /* A constant response with nothing ahead of it is written from here, without a worker */
+        bool prebuilt = exchange->route && exchange->route->prebuilt.wire && readsOnly(exchange->req);
+        if (prebuilt && !hasBody(exchange->req) && !connection->batchRunning && connection->parsed.empty())
+        {
+            writeStatic(exchange);
+            connection->queue(exchange);
+            answered = true;
+            continue;
+        }
+
+        if (!startBody(connection, exchange))
+        {
+            break;
+        }
+    }
+
+    if (answered && !connection->broken && !connection->flush())
+    {
+        connection->broken = true;
+    }
+
+    /* Someone was waiting for more of the body and it will never come */
+    Exchange* reading = connection->reading;
+    BodyStream* stream = reading ? reading->req.stream : nullptr;
+    if (connection->peerClosed && reading && (!stream || stream->flowing || stream->pendingRead))
+    {
+        abortBody(connection);
+    }
+
+    if (!connection->batchRunning && !connection->parsed.empty())
+    {
+        dispatchBatch(connection);
+    }
+}
+
+void
+App::reject(Connection* connection, std::string_view response)
+{
+    /* Answered after everything pipelined before it, then the connection closes; the rest of the input is dropped unread */
+    connection->rejection = response;
+    connection->closeAfterWrite = true;
+    connection->consume(connection->unparsed().size());
+}
+
+int
+App::screen(const Request& req) const
+{
+    /* A throwing filter refuses its own request; the loop it runs on carries on */
+    try
+    {
+        for (const Filter& filter : filters)
+        {
+            int status = filter(req);
+            if (status != 0)
+            {
+                return status;
+            }
+        }
+    }
+    catch (...)
+    {
+        return 500;
+    }
+    return 0;
+}
+
+void
+App::refuse(Connection* connection, Exchange* exchange, int status)
+{
+    /* Answered in order without running a handler; a body we won't read leaves the connection unusable */
+    exchange->route = nullptr;
+    exchange->awaitingContinue = false;
+    exchange->res.status(status).sendStatic(Response::reason(status));
+    if (hasBody(exchange->req))
+    {
+        exchange->keepAlive = false;
+        connection->closeAfterWrite = true;
+        connection->consume(connection->unparsed().size());
+    }
+    connection->parsed.push_back(exchange);
+}
+
+void
+App::sendContinue(Connection* connection, Exchange* exchange)
+{
+    /* Interim response: the client may send the body now */
+    exchange->awaitingContinue = false;
+    connection->queue(CONTINUE.data(), CONTINUE.size());
+}
+
+bool
+App::startBody(Connection* connection, Exchange* exchange)
+{
+    const Request& req = exchange->req;
+    BodyDecoder& decoder = connection->decoder;
+    bool streaming = exchange->route && exchange->route->options.streamBody;
+
+    std::string_view transferEncoding = req.getHeader(HeaderId::TransferEncoding);
+    std::string_view contentLength = req.getHeader(HeaderId::ContentLength);
+    if (!transferEncoding.empty())
+    {
+        /* Both framings at once is how requests get smuggled past proxies */
+        if (!endsWithIgnoreCase(transferEncoding, "chunked") || !contentLength.empty())
+        {
+            --connection->inFlight;
+            exchange->release();
+            reject(connection, BAD_REQUEST);
+            return false;
+        }
+        decoder.expectChunked();
+    }
+    else if (!contentLength.empty())
     {
-        std::lock_guard<std::mutex> lock(routesMutex);
-        auto it = routes.find(req.path);
-        if (it != routes.end())
+        uint64_t length = 0;
+        auto result = std::from_chars(contentLength.data(), contentLength.data() + contentLength.size(), length);
+        if (result.ec != std::errc() || result.ptr != contentLength.data() + contentLength.size())
         {
-            it->second(req, res); // Call the route handler
+            --connection->inFlight;
+            exchange->release();
+            reject(connection, BAD_REQUEST);
+            return false;
         }
+        if (!streaming)
+        {
+            if (length > limits.maxRequestSize)
+            {
+                --connection->inFlight;
+                exchange->release();
+                reject(connection, PAYLOAD_TOO_LARGE);
+                return false;
+            }
+            exchange->req.body.reserve(static_cast<size_t>(length));
+        }
+        decoder.expectLength(length);
+    }
+    else
+    {
+        decoder.expectLength(0);
+    }
+
+    if (decoder.done())
+    {
+        connection->parsed.push_back(exchange);
+        return true;
     }
 
-    if (res.body.empty())
+    /* Behind other requests it has to wait for their responses, or it would arrive before them */
+    if (exchange->awaitingContinue && connection->inFlight == 1)
     {
-        res.status(404).send("Not Found");
+        sendContinue(connection, exchange);
     }
 
-    send(clientSocket, res.toHttpResponse().c_str(), res.toHttpResponse().size(), 0);
-    close(clientSocket);
+    if (!streaming)
+    {
+        connection->reading = exchange;
+        return true;
+    }
+
+    /* Streaming: the handler runs now and the body follows it */
+    BodyStream* stream = &exchange->bodyStream;
+    stream->requestRead = [this, exchange](std::coroutine_handle<> handle)
+    {
+        loop.post([this, exchange, handle]
+        {
+            onReadRequested(exchange, handle);
+        });
+    };
+    exchange->req.stream = stream;
+    connection->reading = exchange;
+    connection->parsed.push_back(exchange);
+    return true;
+}
+
+bool
+App::feedBody(Connection* connection)
+{
+    Exchange* exchange = connection->reading;
+    BodyStream* stream = exchange->req.stream;
+    BodyDecoder& decoder = connection->decoder;
+
+    while (!decoder.done())
+    {
+        if (stream && !stream->flowing && !stream->pendingRead)
+        {
+            /* Nobody is consuming yet; the data waits in the read buffer */
+            return false;
+        }
+
+        std::string_view data;
+        bool toReader = stream && !stream->flowing;
+        size_t consumed = decoder.next(connection->unparsed(), data, toReader ? STREAM_CHUNK_SIZE : SIZE_MAX);
+        connection->consume(consumed);
+
+        if (decoder.failed())
+        {
+            if (!stream)
+            {
+                connection->reading = nullptr;
+                --connection->inFlight;
+                exchange->release();
+                reject(connection, BAD_REQUEST);
+            }
+            else
+            {
+                abortBody(connection);
+            }
+            return false;
+        }
+
+        if (!stream)
+        {
+            if (exchange->req.body.size() + data.size() > limits.maxRequestSize)
+            {
+                connection->reading = nullptr;
+                --connection->inFlight;
+                exchange->release();
+                reject(connection, PAYLOAD_TOO_LARGE);
+                return false;
+            }
+            exchange->req.body.append(data);
+        }
+        else if (stream->flowing)
+        {
+            if (!data.empty() && stream->dataCallback)
+            {
+                stream->dataCallback(data);
+            }
+        }
+        else if (!data.empty())
+        {
+            stream->chunk.assign(data);
+            resumeReader(exchange);
+        }
+
+        if (consumed == 0)
+        {
+            return false;
+        }
+    }
+
+    connection->reading = nullptr;
+    if (!stream)
+    {
+        connection->parsed.push_back(exchange);
+    }
+    else
+    {
+        endBody(exchange);
+    }
+    return true;
+}
+
+void
+App::endBody(Exchange* exchange)
+{
+    BodyStream* stream = exchange->req.stream;
+    stream->complete = true;
+
+    if (stream->pendingRead)
+    {
+        /* An empty chunk tells read() the body is over */
+        stream->chunk.clear();
+        stream->ended = true;
+        resumeReader(exchange);
+    }
+    else if (stream->flowing)
+    {
+        stream->ended = true;
+        if (stream->endCallback)
+        {
+            stream->endCallback();
+        }
+        threadPool.enqueue([this, exchange]
+        {
+            complete(exchange);
+        }, exchange->route->options.priority);
+    }
+}
+
+void
+App::abortBody(Connection* connection)
+{
+    /* The body can't be completed (peer gone or bad framing); close once the response is out */
+    Exchange* exchange = connection->reading;
+    connection->reading = nullptr;
+    connection->closeAfterWrite = true;
+
+    if (!exchange->req.stream)
+    {
+        --connection->inFlight;
+        exchange->release();
+        return;
+    }
+    endBody(exchange);
+}
+
+void
+App::resumeReader(Exchange* exchange)
+{
+    std::coroutine_handle<> handle = std::exchange(exchange->bodyStream.pendingRead, {});
+    threadPool.enqueue([handle]
+    {
+        handle.resume();
+    }, exchange->route->options.priority);
+}
+
+void
+App::onReadRequested(Exchange* exchange, std::coroutine_handle<> handle)
+{
+    BodyStream* stream = exchange->req.stream;
+    stream->pendingRead = handle;
+    if (stream->complete)
+    {
+        stream->chunk.clear();
+        stream->ended = true;
+        resumeReader(exchange);
+        return;
+    }
+
+    Connection* connection = exchange->connection;
+    parseRequests(connection);
+    updateInterest(connection);
+}
+
+void
+App::startFlowing(Exchange* exchange)
+{
+    /* The handler is done; whatever body is left goes to its callbacks, or is drained */
+    BodyStream* stream = exchange->req.stream;
+    stream->flowing = true;
+    if (stream->complete)
+    {
+        endBody(exchange);
+        return;
+    }
+
+    Connection* connection = exchange->connection;
+    parseRequests(connection);
+    updateInterest(connection);
+}
+
+void
+App::dispatchBatch(Connection* connection)
+{
+    connection->batch.assign(connection->parsed.begin(), connection->parsed.end());
+    connection->parsed.clear();
+    for (size_t i = 0; i < connection->batch.size(); ++i)
+    {
+        connection->batch[i]->batchIndex = i;
+    }
+    connection->batchRunning = true;
+
+    const Route* route = connection->batch.front()->route.get();
+    threadPool.enqueue([this, connection]
+    {
+        continueBatch(connection, 0);
+    }, route ? route->options.priority : Priority::High);
+}
+
+void
+App::batchDone(Connection* connection)
+{
+    connection->batchRunning = false;
+
+    /* All responses of the batch go out together in as few writev calls as possible */
+    Exchange* upgraded = nullptr;
+    for (Exchange* exchange : connection->batch)
+    {
+        if (exchange->webSocket)
+        {
+            /* The handshake request lives on until the open handler has seen it */
+            connection->queue(std::string(exchange->wire));
+            upgraded = exchange;
+            continue;
+        }
+        if (exchange->res.eventStream)
+        {
+            /* Pipelining behind an event stream can't be answered, nor does HEAD get one; close after it instead */
+            bool last = exchange == connection->batch.back() && connection->parsed.empty() && !connection->reading;
+            if (last && !connection->closeAfterWrite && !omitsBody(exchange))
+            {
+                connection->eventStream = true;
+                exchange->res.eventStream->add(connection);
+            }
+            else
+            {
+                connection->closeAfterWrite = true;
+            }
+        }
+        connection->queue(exchange);
+    }
+    connection->batch.clear();
+    if (upgraded)
+    {
+        openWebSocket(connection, upgraded);
+    }
+
+    /* Every response ahead of the body being read is queued now */
+    Exchange* reading = connection->reading;
+    if (reading && reading->awaitingContinue && !reading->req.stream && connection->parsed.empty())
+    {
+        sendContinue(connection, reading);
+    }
+
+    if (connection->parsed.empty() && !connection->rejection.empty())
+    {
+        connection->queue(connection->rejection.data(), connection->rejection.size());
+        connection->rejection = {};
+    }
+
+    if (!connection->broken && !connection->flush())
+    {
+        connection->broken = true;
+    }
+
+    if (!connection->broken)
+    {
+        parseRequests(connection);
+    }
+    updateInterest(connection);
+}
+
+void
+App::updateInterest(Connection* connection)
+{
+    if (connection->broken && connection->reading)
+    {
+        abortBody(connection);
+    }
+
+    WebSocket* socket = connection->webSocket.get();
+    if (socket && socket->connection)
+    {
+        socket->queued.store(connection->outputSize(), std::memory_order_relaxed);
+        if (!connection->hasOutput() && socket->backpressured.exchange(false, std::memory_order_relaxed))
+        {
+            socket->inbox.push_back(WebSocket::Event{WebSocket::Event::Drain});
+            runWebSocket(connection->webSocket);
+        }
+    }
+
+    bool idle = !connection->batchRunning && connection->parsed.empty() && !connection->reading
+        && (!connection->http2 || connection->http2->idle());
+    if (idle && !connection->rejection.empty())
+    {
+        connection->queue(connection->rejection.data(), connection->rejection.size());
+        connection->rejection = {};
+        if (!connection->flush())
+        {
+            connection->broken = true;
+        }
+    }
+
+    bool finished = connection->broken || ((connection->peerClosed || connection->closeAfterWrite) && !connection->hasOutput()
+        && !connection->awaitingZeroCopy());
+    if (idle && finished)
+    {
+        closeConnection(connection);
+        return;
+    }
+
+    /* HTTP/2 bounds concurrency with MAX_CONCURRENT_STREAMS instead of the pipeline depth */
+    bool wantsInput = connection->reading
+        || (!connection->closeAfterWrite && (connection->http2 || connection->inFlight < limits.maxPipelineDepth));
+    if (socket && socket->connection)
+    {
+        /* Stop reading while the handlers are this far behind */
+        wantsInput = !connection->closeAfterWrite && socket->inboxBytes < limits.maxRequestSize;
+    }
+    uint32_t wanted = 0;
+    if (!connection->peerClosed && wantsInput && connection->unparsed().size() < limits.maxRequestSize)
+    {
+        wanted |= EPOLLIN;
+    }
+    if (connection->hasOutput() && !connection->broken)
+    {
+        wanted |= EPOLLOUT;
+    }
+
+    if (connection->broken && connection->interest != 0)
+    {
+        /* Wait for the running batch without spinning on the error condition */
+        loop.remove(connection->fd);
+        connection->interest = 0;
+    }
+    else if (!connection->broken && wanted != connection->interest)
+    {
+        loop.modify(connection->fd, wanted);
+        connection->interest = wanted;
+    }
+}
+
+void
+App::closeConnection(Connection* connection)
+{
+    std::vector<Channel*> subscribed = connection->channels;
+    for (Channel* channel : subscribed)
+    {
+        channel->remove(connection);
+    }
+
+    std::shared_ptr<WebSocket> socket = connection->webSocket;
+    if (socket && socket->connection)
+    {
+        /* onClose gets the code of the close handshake, or 1006 if there was none */
+        socket->connection = nullptr;
+        socket->close();
+        socket->inbox.push_back(WebSocket::Event{WebSocket::Event::Closed, false, socket->closeCode, socket->closeReason});
+        runWebSocket(socket);
+    }
+    if (connection->interest != 0)
+    {
+        loop.remove(connection->fd);
+    }
+    connections.erase(connection->fd);
+}
+
+bool
+App::startHttp2(Connection* connection, Exchange* upgraded)
+{
+    auto session = std::make_unique<Http2Session>(*connection, limits.maxRequestSize, defaultHeaders, [this](Exchange* exchange)
+    {
+        dispatchStream(exchange);
+    });
+
+    if (upgraded)
+    {
+        /* Bad HTTP2-Settings: ignore the upgrade and answer over HTTP/1.1 */
+        if (!session->upgrade(upgraded->req.getHeader(HeaderId::Http2Settings), upgraded))
+        {
+            return false;
+        }
+        /* The 101 goes out first, then our SETTINGS, then the response to the upgraded request */
+        connection->queue(SWITCHING_TO_H2C.data(), SWITCHING_TO_H2C.size());
+    }
+    session->start();
+    connection->http2 = std::move(session);
+    return true;
+}
+
+void
+App::receiveHttp2(Connection* connection)
+{
+    connection->http2->receive();
+    if (!connection->broken && !connection->flush())
+    {
+        connection->broken = true;
+    }
+}
+
+void
+App::dispatchStream(Exchange* exchange)
+{
+    /* Streams are independent, so each one runs on its own as soon as its request is complete */
+    exchange->route = findRoute(exchange->req.path);
+    int refusal = screen(exchange->req);
+    if (refusal != 0)
+    {
+        exchange->route = nullptr;
+        exchange->res.status(refusal).sendStatic(Response::reason(refusal));
+    }
+    const Route* route = exchange->route.get();
+    threadPool.enqueue([this, exchange]
+    {
+        respond(exchange);
+    }, route ? route->options.priority : Priority::High);
+}
+
+void
+App::http2Respond(Exchange* exchange)
+{
+    Connection* connection = exchange->connection;
+    connection->http2->respond(exchange);
+    if (!connection->broken && !connection->flush())
+    {
+        connection->broken = true;
+    }
+    updateInterest(connection);
+}
+
+std::shared_ptr<WebSocket>
+App::makeWebSocket(Priority priority)
+{
+    /* send() may come from any thread; frames are queued on the loop */
+    return std::make_shared<WebSocket>(priority, limits.maxRequestSize, limits.maxWebSocketBackpressure,
+        [this](std::shared_ptr<WebSocket> socket, std::string frame)
+        {
+            loop.post([this, socket = std::move(socket), frame = std::move(frame)]() mutable
+            {
+                deliverWebSocket(socket, std::move(frame));
+            });
+        });
+}
+
+void
+App::openWebSocket(Connection* connection, Exchange* exchange)
+{
+    std::shared_ptr<WebSocket> socket = exchange->webSocket;
+    socket->connection = connection;
+    socket->handshake = exchange;
+    connection->headParser = HeadParser();
+    --connection->inFlight;
+
+    socket->inbox.push_back(WebSocket::Event{WebSocket::Event::Open});
+    runWebSocket(socket);
+}
+
+void
+App::receiveWebSocket(Connection* connection)
+{
+    std::shared_ptr<WebSocket> socket = connection->webSocket;
+    std::string replies;
+    connection->consume(socket->receive(connection->unparsed(), replies));
+    if (socket->closeSent)
+    {
+        /* Nothing after a close is read */
+        connection->consume(connection->unparsed().size());
+        connection->closeAfterWrite = true;
+    }
+    if (!replies.empty())
+    {
+        connection->queue(std::move(replies));
+    }
+    connection->releaseInput();
+    runWebSocket(socket);
+}
+
+void
+App::deliverWebSocket(const std::shared_ptr<WebSocket>& socket, std::string frame)
+{
+    socket->posted.fetch_sub(frame.size(), std::memory_order_relaxed);
+    Connection* connection = socket->connection;
+    if (!connection || !socket->admit(frame))
+    {
+        return;
+    }
+
+    /* Written on the next EPOLLOUT, together with whatever else is sent before it */
+    connection->queue(std::move(frame));
+    if (socket->closeSent)
+    {
+        connection->closeAfterWrite = true;
+    }
+    updateInterest(connection);
+}
+
+void
+App::runWebSocket(const std::shared_ptr<WebSocket>& socket)
+{
+    if (socket->running || socket->inbox.empty())
+    {
+        return;
+    }
+    socket->running = true;
+
+    std::vector<WebSocket::Event> events;
+    events.swap(socket->inbox);
+    threadPool.enqueue([this, socket, events = std::move(events)]() mutable
+    {
+        size_t bytes = 0;
+        for (WebSocket::Event& event : events)
+        {
+            try
+            {
+                switch (event.kind)
+                {
+                    case WebSocket::Event::Open:
+                    {
+                        std::unique_ptr<Exchange, void (*)(Exchange*)> handshake(std::exchange(socket->handshake, nullptr),
+                            [](Exchange* exchange) { exchange->release(); });
+                        handshake->route->webSocketHandler(socket, handshake->req);
+                        break;
+                    }
+                    case WebSocket::Event::Message:
+                        bytes += event.data.size();
+                        if (socket->onMessage)
+                        {
+                            socket->onMessage(event.data, event.binary);
+                        }
+                        break;
+                    case WebSocket::Event::Drain:
+                        if (socket->onDrain)
+                        {
+                            socket->onDrain();
+                        }
+                        break;
+                    case WebSocket::Event::Closed:
+                        if (socket->onClose)
+                        {
+                            socket->onClose(event.code, event.data);
+                        }
+                        /* Callbacks often capture the socket; dropping them breaks the cycle */
+                        socket->onMessage = nullptr;
+                        socket->onClose = nullptr;
+                        socket->onDrain = nullptr;
+                        break;
+                }
+            }
+            catch (...)
+            {
+                socket->close(1011);
+            }
+        }
+
+        loop.post([this, socket, bytes]
+        {
+            socket->running = false;
+            socket->inboxBytes -= bytes;
+            runWebSocket(socket);
+            if (socket->connection)
+            {
+                updateInterest(socket->connection);
+            }
+        });
+    }, socket->priority);
+}
+
+void
+App::continueBatch(Connection* connection, size_t index)
+{
+    if (index == connection->batch.size())
+    {
+        loop.post([this, connection]
+        {
+            batchDone(connection);
+        });
+        return;
+    }
+
+    /* Run in order; hop lanes only when the next route asks for a different priority */
+    Exchange* exchange = connection->batch[index];
+    Priority priority = exchange->route ? exchange->route->options.priority : Priority::High;
+    if (index > 0 && priority != ThreadPool::currentPriority())
+    {
+        threadPool.enqueue([this, exchange]
+        {
+            respond(exchange);
+        }, priority);
+        return;
+    }
+    respond(exchange);
+}
+
+void
+App::respond(Exchange* exchange)
+{
+    const Route* route = exchange->route.get();
+
+    if (route && route->webSocketHandler)
+    {
+        if (exchange->webSocket)
+        {
+            /* The handler itself runs once the 101 is out */
+            exchange->wire.append(SWITCHING_TO_WEBSOCKET);
+            exchange->wire.append(WebSocket::acceptKey(exchange->req.getHeader(HeaderId::SecWebSocketKey)));
+            exchange->wire.append("\r\n\r\n");
+            continueBatch(exchange->connection, exchange->batchIndex + 1);
+            return;
+        }
+        exchange->res.status(426).setHeader("Upgrade", "websocket").sendStatic("Upgrade Required");
+        complete(exchange);
+        return;
+    }
+
+    if (route && route->prebuilt.wire && !readsOnly(exchange->req))
+    {
+        exchange->res.status(405).setHeader("Allow", "GET, HEAD").sendStatic("Method Not Allowed");
+        complete(exchange);
+        return;
+    }
+    if (route && route->prebuilt.wire)
+    {
+        if (exchange->streamId != 0)
+        {
+            route->prebuilt.restore(exchange->res);
+            exchange->res.setHeader("Date", httpDate());
+            complete(exchange);
+            return;
+        }
+        writeStatic(exchange);
+        continueBatch(exchange->connection, exchange->batchIndex + 1);
+        return;
+    }
+
+    bool shared = route && (route->cache || route->flights) && readsOnly(exchange->req);
+    if (shared && !exchange->cacheRefresh && !exchange->alone)
+    {
+        buildCacheKey(exchange);
+        if (route->cache && serveCached(exchange))
+        {
+            return;
+        }
+        exchange->leadsFlight = route->flights && route->flights->join(exchange->cacheKey, exchange);
+        if (route->flights && !exchange->leadsFlight)
+        {
+            /* Answered when the request leading the flight completes */
+            return;
+        }
+    }
+
+    if (route && route->asyncHandler)
+    {
+        Task<> task = route->asyncHandler(exchange->req, exchange->res);
+
+        /* Runs until the first suspension; completion may happen on any worker */
+        task.start([this, exchange](std::exception_ptr error)
+        {
+            if (error)
+            {
+                exchange->res.status(500).sendStatic("Internal Server Error");
+            }
+            complete(exchange);
+        });
+        return;
+    }
+
+    if (route && route->handler)
+    {
+        /* A throwing handler fails its own request, not the worker it runs on */
+        try
+        {
+            route->handler(exchange->req, exchange->res); // Call the route handler
+        }
+        catch (...)
+        {
+            exchange->res.deferred = nullptr;
+            exchange->res.status(500).sendStatic("Internal Server Error");
+        }
+    }
+    complete(exchange);
+}
+
+void
+App::complete(Exchange* exchange)
+{
+    BodyStream* stream = exchange->req.stream;
+    if (stream && !stream->ended)
+    {
+        /* The loop finishes the body first and completes the exchange after it */
+        loop.post([this, exchange]
+        {
+            startFlowing(exchange);
+        });
+        return;
+    }
+
+    Response& res = exchange->res;
+    if (res.deferred)
+    {
+        runDeferred(exchange);
+        return;
+    }
+
+    if (res.eventStream && exchange->streamId != 0)
+    {
+        res.eventStream = nullptr;
+        res.status(505).sendStatic("Event streams need HTTP/1.1");
+    }
+    if (res.content().empty() && !res.eventStream)
+    {
+        res.status(404).sendStatic("Not Found");
+    }
+    if (compression && !res.eventStream)
+    {
+        compressResponse(exchange);
+    }
+
+    if (!exchange->cacheKey.empty())
+    {
+        share(exchange);
+    }
+    if (exchange->cacheRefresh)
+    {
+        exchange->release();
+        return;
+    }
+
+    if (exchange->streamId != 0)
+    {
+        /* HTTP/2 frames the response on the loop thread */
+        loop.post([this, exchange]
+        {
+            http2Respond(exchange);
+        });
+        return;
+    }
+
+    if (!exchange->keepAlive)
+    {
+        res.setHeader("Connection", "close");
+    }
+    else if (exchange->req.version == "HTTP/1.0")
+    {
+        res.setHeader("Connection", "keep-alive");
+    }
+
+    /* The body stays where the handler left it and is written from there, unless it is small */
+    std::string_view body = omitsBody(exchange) ? std::string_view() : res.content();
+    bool copyBody = body.size() <= INLINE_BODY_SIZE;
+    exchange->wire.reserve((copyBody ? body.size() : 0) + 256);
+    res.serializeHead(exchange->wire, &defaultHeaders);
+    if (copyBody)
+    {
+        exchange->wire.append(body);
+    }
+    else
+    {
+        exchange->wireBody = body;
+    }
+    continueBatch(exchange->connection, exchange->batchIndex + 1);
+}
+
+void
+App::compressResponse(Exchange* exchange)
+{
+    Response& res = exchange->res;
+    if (res.statusCode < 200 || res.statusCode == 204 || res.statusCode == 304 || res.headers.has("Content-Encoding")
+        || !isCompressible(res.headers.get("Content-Type"), res.content().size(), *compression))
+    {
+        return;
+    }
+
+    /* The body now depends on Accept-Encoding, so caches have to key on it */
+    std::string_view vary = res.headers.get("Vary");
+    if (vary.empty())
+    {
+        res.setHeader("Vary", "Accept-Encoding");
+    }
+    else if (!containsIgnoreCase(vary, "Accept-Encoding") && vary != "*")
+    {
+        res.setHeader("Vary", std::string(vary) + ", Accept-Encoding");
+    }
+
+    ContentEncoding encoding = negotiateEncoding(exchange->req.getHeader(HeaderId::AcceptEncoding));
+    std::pmr::string compressed(res.body.get_allocator());
+    if (compressBody(res.content(), compressed, encoding, *compression))
+    {
+        res.body.swap(compressed);
+        res.external = {};
+        res.setHeader("Content-Encoding", encoding == ContentEncoding::Gzip ? "gzip" : "deflate");
+    }
+}
+
+void
+App::buildCacheKey(Exchange* exchange)
+{
+    /* Target, the vary header values, and the coding the body would be compressed with */
+    const Request& req = exchange->req;
+    std::pmr::string& key = exchange->cacheKey;
+    key.append(req.url);
+    for (const std::string& name : exchange->route->options.cache.varyHeaders)
+    {
+        key.push_back('\n');
+        key.append(req.getHeader(name));
+    }
+    if (compression)
+    {
+        key.push_back('\n');
+        key.push_back(static_cast<char>('0' + static_cast<int>(negotiateEncoding(req.getHeader(HeaderId::AcceptEncoding)))));
+    }
+}
+
+bool
+App::serveCached(Exchange* exchange)
+{
+    ResponseCache::Hit hit;
+    if (!exchange->route->cache->lookup(exchange->cacheKey, hit))
+    {
+        return false;
+    }
+    if (hit.refresh)
+    {
+        refreshCached(exchange);
+    }
+    exchange->cacheKey.clear();
+    answerShared(exchange, hit.response);
+    return true;
+}
+
+void
+App::refreshCached(Exchange* exchange)
+{
+    /* A copy of the request renders the new entry in the background; this one is answered from the stale one */
+    const Request& req = exchange->req;
+    RequestHead head;
+    head.method = req.method;
+    head.target = req.url;
+    head.version = req.version;
+    for (const Headers::Field& field : req.headers)
+    {
+        head.fields.push_back(RequestHead::Field{field.name, field.value});
+    }
+
+    Exchange* refresh = Exchange::create(head);
+    refresh->route = exchange->route;
+    refresh->cacheKey = exchange->cacheKey;
+    refresh->cacheRefresh = true;
+    threadPool.enqueue([this, refresh]
+    {
+        respond(refresh);
+    }, Priority::Low);
+}
+
+void
+App::share(Exchange* exchange)
+{
+    const Route& route = *exchange->route;
+    const Response& res = exchange->res;
+    bool shareable = isShareable(res);
+    bool cacheable = route.cache && shareable && res.statusCode == 200;
+    if (exchange->cacheRefresh && !cacheable)
+    {
+        route.cache->abandonRefresh(exchange->cacheKey);
+    }
+
+    /* With a cache entry to store, the flight lands after it, so later requests find the entry instead of a new flight */
+    std::vector<Exchange*> waiters;
+    if (exchange->leadsFlight && !cacheable)
+    {
+        waiters = route.flights->land(exchange->cacheKey);
+    }
+
+    /* Serialized once, for the cache and for every request that waited on this one */
+    SharedResponse shared;
+    if (cacheable || (shareable && !waiters.empty()))
+    {
+        std::pmr::string wire(exchange->wire.get_allocator());
+        res.serialize(wire, &defaultHeaders);
+        shared = SharedResponse::make(std::string(wire));
+    }
+    if (cacheable)
+    {
+        route.cache->store(exchange->cacheKey, shared);
+        if (exchange->leadsFlight)
+        {
+            waiters = route.flights->land(exchange->cacheKey);
+        }
+    }
+
+    for (Exchange* waiter : waiters)
+    {
+        /* A response that can't be shared leaves each waiter to run the handler itself */
+        waiter->alone = !shared.wire;
+        threadPool.enqueue([this, waiter, shared]
+        {
+            if (shared.wire)
+            {
+                answerShared(waiter, shared);
+            }
+            else
+            {
+                respond(waiter);
+            }
+        }, route.options.priority);
+    }
+}
+
+void
+App::answerShared(Exchange* exchange, const SharedResponse& response)
+{
+    exchange->cacheKey.clear();
+    if (exchange->streamId != 0)
+    {
+        response.restore(exchange->res);
+        complete(exchange);
+        return;
+    }
+
+    writeShared(exchange, response);
+    continueBatch(exchange->connection, exchange->batchIndex + 1);
+}
+
+void
+App::writeStatic(Exchange* exchange)
+{
+    const Route& route = *exchange->route;
+    writeShared(exchange, route.prebuilt);
+
+    std::string_view date = httpDate();
+    std::copy(date.begin(), date.end(), exchange->wire.begin() + route.dateOffset);
+}
+
+void
+App::runDeferred(Exchange* exchange)
+{
+    Priority priority = ThreadPool::currentPriority();
+    computePool.enqueue([this, exchange, priority]
+    {
+        std::function<void()> work = std::move(exchange->res.deferred);
+        exchange->res.deferred = nullptr;
+        try
+        {
+            work();
+        }
+        catch (...)
+        {
+            exchange->res.status(500).sendStatic("Internal Server Error");
+        }
+
+        /* The rest of the batch goes back to the I/O workers so compute threads only compute */
+        threadPool.enqueue([this, exchange]
+        {
+            complete(exchange);
+        }, priority);
+    });
+}
+
+EventAwaiter
+App::resumeAfter(std::function<void(EventLoop::Callback)> arm)
+{
+    Priority priority = ThreadPool::currentPriority();
+    return EventAwaiter([this, priority, arm = std::move(arm)](std::function<void()> resume)
+    {
+        arm([this, priority, resume = std::move(resume)]
+        {
+            threadPool.enqueue(resume, priority);
+        });
+    });
+}
+
+EventAwaiter
+App::sleep(std::chrono::milliseconds delay)
+{
+    return resumeAfter([this, delay](EventLoop::Callback done)
+    {
+        loop.setTimeout(delay, std::move(done));
+    });
+}
+
+EventAwaiter
+App::readable(int fd)
+{
+    return resumeAfter([this, fd](EventLoop::Callback done)
+    {
+        loop.watch(fd, EPOLLIN, std::move(done));
+    });
+}
+
+EventAwaiter
+App::writable(int fd)
+{
+    return resumeAfter([this, fd](EventLoop::Callback done)
+    {
+        loop.watch(fd, EPOLLOUT, std::move(done));
+    });
+}
+
+Task<ssize_t>
+App::read(int fd, void* buffer, size_t length)
+{
+    /* fd must be non-blocking */
+    while (true)
+    {
+        ssize_t bytesRead = ::read(fd, buffer, length);
+        if (bytesRead >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            co_return bytesRead;
+        }
+        co_await readable(fd);
+    }
+}
+
+Task<ssize_t>
+App::write(int fd, const void* data, size_t length)
+{
+    /* fd must be a non-blocking socket; returns once everything is written */
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t sent = ::send(fd, static_cast<const char*>(data) + written, length - written, MSG_NOSIGNAL);
+        if (sent >= 0)
+        {
+            written += sent;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            co_await writable(fd);
+        }
+        else
+        {
+            co_return -1;
+        }
+    }
+    co_return static_cast<ssize_t>(written);
+}
+
+Task<int>
+App::connect(const std::string& address, int port)
+{
+    sockaddr_in remote{};
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &remote.sin_addr) != 1)
+    {
+        co_return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        co_return -1;
+    }
+
+    if (::connect(fd, (struct sockaddr*)&remote, sizeof(remote)) < 0)
+    {
+        if (errno != EINPROGRESS)
+        {
+            close(fd);
+            co_return -1;
+        }
+
+        co_await writable(fd);
+
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) < 0 || error != 0)
+        {
+            close(fd);
+            co_return -1;
+        }
+    }
+    co_return fd;
+}
+
+Task<std::optional<std::string>>
+App::readFile(std::string path)
+{
+    std::optional<std::string> content;
+    Priority priority = ThreadPool::currentPriority();
+
+    co_await EventAwaiter([this, &path, &content, priority](std::function<void()> resume)
+    {
+        fsPool.enqueue([this, &path, &content, priority, resume = std::move(resume)]
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (file.is_open())
+            {
+                std::ostringstream buffer;
+                buffer << file.rdbuf();
+                content = buffer.str();
+            }
+            threadPool.enqueue(resume, priority);
+        });
+    });
+    co_return content;
 }
 
 bool
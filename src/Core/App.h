@@ -1,34 +1,296 @@
 #pragma once
 
 #include <string>
+#include <optional>
+#include <chrono>
+#include <memory>
+#include <type_traits>
 #include <unordered_map>
 #include <mutex>
 #include <functional>
+#include <vector>
 #include "ThreadPool.h"
+#include "Arena.h"
+#include "EventLoop.h"
+#include "Task.h"
 #include "ReqRes.h"
+#include "Route.h"
+#include "Exchange.h"
+#include "Connection.h"
+#include "Channel.h"
+#include "Compression.h"
 #include "flog.h"
 
-class App 
+/* Per-connection resource limits */
+struct ServerLimits
+{
+    size_t maxPipelineDepth = 16;           /* Requests read ahead of their responses */
+    size_t maxRequestSize = 1024 * 1024;    /* Request body, larger ones get 413; also a WebSocket message */
+    size_t maxHeaderSize = 64 * 1024;       /* Request line and header fields; larger heads get 431 */
+    size_t maxUriLength = 8 * 1024;         /* Longer request targets get 414 */
+    size_t maxHeaderCount = 100;            /* More header fields get 431 */
+    size_t maxWebSocketBackpressure = 1024 * 1024;  /* Unwritten bytes before a WebSocket or channel subscriber counts as slow */
+};
+
+class App
 {
 public:
-    using RouteHandler = std::function<void(const Request&, Response&)>;
+    using RouteHandler = Route::Handler;
+    using AsyncRouteHandler = Route::AsyncHandler;
+    /* Returns 0 to let a request through, or the status to refuse it with */
+    using Filter = std::function<int(const Request& req)>;
 
     App();
     explicit App(size_t ThreadCount);
 
     void listen(int port, std::function<void()> onStart);
-    void get(const std::string& path, RouteHandler handler);
-    void post(const std::string& path, RouteHandler handler);
+
+    /* Handlers either fill `res` and return, or return a Task<> and co_await the helpers below */
+    template<class Handler>
+    void get(const std::string& path, Handler&& handler, RouteOptions options = {});
+    template<class Handler>
+    void get(const std::string& path, Handler&& handler, Priority priority);
+    /* Cached GET: hits skip the handler until `cache.ttl` runs out */
+    template<class Handler>
+    void get(const std::string& path, Handler&& handler, CacheOptions cache);
+    /*
+     * Constant endpoint: the response is serialized here, with the default
+     * headers set so far, and each request only patches in the Date.
+     */
+    void getStatic(const std::string& path, std::string_view body, std::string_view contentType = "text/plain",
+                   RouteOptions options = {});
+    template<class Handler>
+    void post(const std::string& path, Handler&& handler, RouteOptions options = {});
+    template<class Handler>
+    void post(const std::string& path, Handler&& handler, Priority priority);
+
+    /*
+     * WebSocket endpoint. `handler` runs after the handshake and sets the
+     * socket's onMessage / onClose; a socket's callbacks run one at a time, in
+     * order, in the route's lane.
+     */
+    void ws(const std::string& path, Route::WebSocketHandler handler, RouteOptions options = {});
+
+    /*
+     * Publish/subscribe channel, created on first use and alive as long as the
+     * App. WebSockets join with channel.subscribe(socket), SSE responses with
+     * res.subscribe(channel).
+     */
+    Channel& channel(const std::string& name);
+
+    /*
+     * Checks every request on the event loop as soon as its head is parsed,
+     * before the body is read (over HTTP/2, once the stream's body is in).
+     * A refused request never reaches its handler, and a client that sent
+     * Expect: 100-continue never sends the body. Filters must not block.
+     * Call before listen().
+     */
+    void use(Filter filter);
+
+    /* Queueing delay and depth of one scheduling lane, for monitoring */
+    ThreadPool::LaneStats queueStats(Priority priority) const;
+
+    /* How long idle I/O workers spin before parking; trade CPU for dispatch latency */
+    void setSpinPolicy(const ThreadPool::SpinPolicy& policy);
+
+    /* Sent with every response that doesn't set the same header, e.g. Server or security headers. Call before listen() */
+    void setDefaultHeader(std::string_view name, std::string_view value);
+
+    /*
+     * Compresses response bodies with gzip or deflate when Accept-Encoding
+     * allows it and the body is large enough and not compressed already.
+     * Call before listen().
+     */
+    void enableCompression(const CompressionOptions& options = {});
+
+    /* Call before listen() */
+    void setLimits(const ServerLimits& serverLimits);
+
+    /*
+     * Awaitables for async handlers. The coroutine is parked on the event loop
+     * and resumed on a worker in the lane it was running in.
+     */
+    EventAwaiter sleep(std::chrono::milliseconds delay);
+    EventAwaiter readable(int fd);
+    EventAwaiter writable(int fd);
+    Task<ssize_t> read(int fd, void* buffer, size_t length);
+    Task<ssize_t> write(int fd, const void* data, size_t length);
+    Task<int> connect(const std::string& address, int port);
+    /* Files are not pollable, so like libuv they are read on a small blocking I/O pool */
+    Task<std::optional<std::string>> readFile(std::string path);
+
+    /* Runs CPU-heavy work on the compute pool (one thread per physical core) and resumes with its result */
+    template<class F>
+    Task<std::invoke_result_t<F&>> offload(F work);
 
 private:
     ThreadPool threadPool;
-    std::unordered_map<std::string, RouteHandler> routes;
+    ThreadPool fsPool;
+    ThreadPool computePool;
+    EventLoop loop;
+    std::unordered_map<std::string, std::shared_ptr<const Route>, StringHash, std::equal_to<>> routes;
     std::mutex routesMutex;
+    std::vector<Filter> filters;
+    std::unordered_map<std::string, std::unique_ptr<Channel>, StringHash, std::equal_to<>> channels;
+    std::mutex channelsMutex;
     int serverSocket;
+    ServerLimits limits;
+    HeaderBlock defaultHeaders;     /* Serialized once, copied into every response */
+    std::optional<CompressionOptions> compression;
+
+    /* Owned and touched by the loop thread only */
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+    template<class Handler>
+    static Route makeRoute(Handler&& handler, RouteOptions options);
+    void addRoute(const std::string& path, Route route);
+    std::shared_ptr<const Route> findRoute(std::string_view path);
+
+    /* Loop thread: reading, framing and writing */
+    void openConnection(int clientSocket);
+    void onConnectionEvent(Connection* connection, uint32_t events);
+    void parseRequests(Connection* connection);
+    void reject(Connection* connection, std::string_view response);
+    int screen(const Request& req) const;
+    void refuse(Connection* connection, Exchange* exchange, int status);
+    void sendContinue(Connection* connection, Exchange* exchange);
+    bool startBody(Connection* connection, Exchange* exchange);
+    bool feedBody(Connection* connection);
+    void endBody(Exchange* exchange);
+    void abortBody(Connection* connection);
+    void resumeReader(Exchange* exchange);
+    void onReadRequested(Exchange* exchange, std::coroutine_handle<> handle);
+    void startFlowing(Exchange* exchange);
+    void dispatchBatch(Connection* connection);
+    void batchDone(Connection* connection);
+    void updateInterest(Connection* connection);
+    void closeConnection(Connection* connection);
+
+    /* Loop thread: HTTP/2 connections */
+    bool startHttp2(Connection* connection, Exchange* upgraded);
+    void receiveHttp2(Connection* connection);
+    void dispatchStream(Exchange* exchange);
+    void http2Respond(Exchange* exchange);
+
+    /* Loop thread: WebSocket connections */
+    std::shared_ptr<WebSocket> makeWebSocket(Priority priority);
+    void openWebSocket(Connection* connection, Exchange* exchange);
+    void receiveWebSocket(Connection* connection);
+    void deliverWebSocket(const std::shared_ptr<WebSocket>& socket, std::string frame);
+    void runWebSocket(const std::shared_ptr<WebSocket>& socket);
 
-    void handleRequest(int clientSocket);
+    /* Workers: running handlers for one pipelined batch, in order */
+    void continueBatch(Connection* connection, size_t index);
+    void respond(Exchange* exchange);
+    void complete(Exchange* exchange);
+    void compressResponse(Exchange* exchange);
+    void buildCacheKey(Exchange* exchange);
+    bool serveCached(Exchange* exchange);
+    void refreshCached(Exchange* exchange);
+    void share(Exchange* exchange);
+    void answerShared(Exchange* exchange, const SharedResponse& response);
+    void writeStatic(Exchange* exchange);
+    void runDeferred(Exchange* exchange);
+    EventAwaiter resumeAfter(std::function<void(EventLoop::Callback)> arm);
 
     bool createServerSocket();
     bool configureServerSocket();
     bool bindServerSocket(int port);
-};
\ No newline at end of file
+};
+
+template<class Handler>
+Route
+App::makeRoute(Handler&& handler, RouteOptions options)
+{
+    Route route;
+    if constexpr (std::is_same_v<std::invoke_result_t<Handler&, const Request&, Response&>, Task<>>)
+    {
+        route.asyncHandler = std::forward<Handler>(handler);
+    }
+    else
+    {
+        route.handler = std::forward<Handler>(handler);
+    }
+    route.options = options;
+    return route;
+}
+
+template<class Handler>
+void
+App::get(const std::string& path, Handler&& handler, RouteOptions options)
+{
+    addRoute(path, makeRoute(std::forward<Handler>(handler), options));
+}
+
+template<class Handler>
+void
+App::get(const std::string& path, Handler&& handler, Priority priority)
+{
+    get(path, std::forward<Handler>(handler), RouteOptions{.priority = priority});
+}
+
+template<class Handler>
+void
+App::get(const std::string& path, Handler&& handler, CacheOptions cache)
+{
+    get(path, std::forward<Handler>(handler), RouteOptions{.cache = std::move(cache)});
+}
+
+template<class Handler>
+void
+App::post(const std::string& path, Handler&& handler, RouteOptions options)
+{
+    addRoute(path, makeRoute(std::forward<Handler>(handler), options));
+}
+
+template<class Handler>
+void
+App::post(const std::string& path, Handler&& handler, Priority priority)
+{
+    post(path, std::forward<Handler>(handler), RouteOptions{.priority = priority});
+}
+
+template<class F>
+Task<std::invoke_result_t<F&>>
+App::offload(F work)
+{
+    using Result = std::invoke_result_t<F&>;
+    using Storage = std::conditional_t<std::is_void_v<Result>, bool, Result>;
+
+    std::optional<Storage> result;
+    std::exception_ptr error;
+    Priority priority = ThreadPool::currentPriority();
+
+    co_await EventAwaiter([this, &work, &result, &error, priority](std::function<void()> resume)
+    {
+        computePool.enqueue([this, &work, &result, &error, priority, resume = std::move(resume)]
+        {
+            try
+            {
+                if constexpr (std::is_void_v<Result>)
+                {
+                    work();
+                    result.emplace(true);
+                }
+                else
+                {
+                    result.emplace(work());
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            threadPool.enqueue(resume, priority);
+        });
+    });
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    if constexpr (!std::is_void_v<Result>)
+    {
+        co_return std::move(*result);
+    }
+}
@@ -0,0 +1,116 @@
+#include "Arena.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    std::atomic<size_t> defaultCapacity{Arena::DefaultCapacity};
+    std::atomic<size_t> peakUsage{0};
+    std::atomic<uint64_t> overflowCount{0};
+
+    std::mutex poolMutex;
+    std::vector<std::unique_ptr<Arena>> pool;
+}
+
+Arena::Arena(size_t capacity)
+    : block(static_cast<char*>(::operator new(capacity, std::align_val_t{alignof(std::max_align_t)}))),
+      size(capacity), offset(0), spilled(0), spills(nullptr)
+{
+}
+
+Arena::~Arena()
+{
+    reset();
+    ::operator delete(block, std::align_val_t{alignof(std::max_align_t)});
+}
+
+void*
+Arena::do_allocate(size_t bytes, size_t alignment)
+{
+    size_t start = (offset + alignment - 1) & ~(alignment - 1);
+    if (start + bytes <= size)
+    {
+        offset = start + bytes;
+        return block + start;
+    }
+
+    /* Slow path: a heap chunk chained to the arena, freed on reset */
+    overflowCount.fetch_add(1, std::memory_order_relaxed);
+    if (alignment < alignof(std::max_align_t))
+    {
+        alignment = alignof(std::max_align_t);
+    }
+    size_t header = (sizeof(Spill) + alignment - 1) & ~(alignment - 1);
+    char* chunk = static_cast<char*>(::operator new(header + bytes, std::align_val_t{alignment}));
+    Spill* spill = reinterpret_cast<Spill*>(chunk);
+    spill->next = spills;
+    spill->alignment = alignment;
+    spills = spill;
+    spilled += bytes;
+    return chunk + header;
+}
+
+void
+Arena::reset()
+{
+    size_t bytes = used();
+    size_t peak = peakUsage.load(std::memory_order_relaxed);
+    while (bytes > peak && !peakUsage.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+    {
+    }
+
+    while (spills)
+    {
+        Spill* next = spills->next;
+        ::operator delete(spills, std::align_val_t{spills->alignment});
+        spills = next;
+    }
+    offset = 0;
+    spilled = 0;
+}
+
+std::unique_ptr<Arena>
+Arena::detach()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!pool.empty())
+        {
+            std::unique_ptr<Arena> arena = std::move(pool.back());
+            pool.pop_back();
+            return arena;
+        }
+    }
+    return std::make_unique<Arena>(defaultCapacity.load(std::memory_order_relaxed));
+}
+
+void
+Arena::release(std::unique_ptr<Arena> arena)
+{
+    arena->reset();
+    if (arena->capacity() != defaultCapacity.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    pool.push_back(std::move(arena));
+}
+
+void
+Arena::setCapacity(size_t capacity)
+{
+    defaultCapacity.store(capacity, std::memory_order_relaxed);
+}
+
+Arena::Stats
+Arena::stats()
+{
+    Stats stats;
+    stats.capacity = defaultCapacity.load(std::memory_order_relaxed);
+    stats.peak = peakUsage.load(std::memory_order_relaxed);
+    stats.overflows = overflowCount.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+/*
+ * Monotonic memory for one request. Allocation bumps an offset in a single
+ * preallocated block, deallocation is a no-op and reset() makes the whole
+ * block reusable. Requests bigger than the block spill to the heap and are
+ * counted, so the capacity can be tuned from stats().
+ *
+ * Arenas come from a shared pool: every Exchange takes one with detach()
+ * when it is created on the loop thread, keeps it wherever the request goes
+ * (a worker, a suspended coroutine) and gives it back with release(), which
+ * resets it for the next request.
+ */
+class Arena : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t DefaultCapacity = 64 * 1024;
+
+    struct Stats
+    {
+        size_t capacity = 0;
+        size_t peak = 0;        /* Highest bytes used by a single request, spills included */
+        uint64_t overflows = 0; /* Allocations that did not fit in the block */
+    };
+
+    explicit Arena(size_t capacity);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template<class T, class... Args>
+    T* create(Args&&... args);
+
+    void reset();
+    size_t used() const { return offset + spilled; }
+    size_t capacity() const { return size; }
+
+    /* An arena from the pool, or a new one when the pool is empty */
+    static std::unique_ptr<Arena> detach();
+    static void release(std::unique_ptr<Arena> arena);
+
+    /* Applies to arenas created from now on */
+    static void setCapacity(size_t capacity);
+    static Stats stats();
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+    struct Spill
+    {
+        Spill* next;
+        size_t alignment;
+    };
+
+    char* block;
+    size_t size;
+    size_t offset;
+    size_t spilled;
+    Spill* spills;
+};
+
+template<class T, class... Args>
+T*
+Arena::create(Args&&... args)
+{
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
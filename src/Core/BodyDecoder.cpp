@@ -0,0 +1,171 @@
+#include "BodyDecoder.h"
+
+#include <algorithm>
+
+namespace
+{
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+void
+BodyDecoder::reset()
+{
+    state = State::Done;
+    remaining = 0;
+    total = 0;
+}
+
+void
+BodyDecoder::expectLength(uint64_t length)
+{
+    reset();
+    remaining = length;
+    state = length > 0 ? State::Length : State::Done;
+}
+
+void
+BodyDecoder::expectChunked()
+{
+    reset();
+    state = State::ChunkSize;
+    sizeDigits = false;
+}
+
+size_t
+BodyDecoder::next(std::string_view input, std::string_view& data, size_t maxData)
+{
+    data = {};
+    size_t pos = 0;
+
+    while (pos < input.size())
+    {
+        char c = input[pos];
+        switch (state)
+        {
+            case State::Done:
+            case State::Error:
+                return pos;
+
+            case State::Length:
+            case State::ChunkData:
+            {
+                size_t take = static_cast<size_t>(std::min<uint64_t>({remaining, input.size() - pos, maxData}));
+                data = input.substr(pos, take);
+                remaining -= take;
+                total += take;
+                if (remaining == 0)
+                {
+                    state = state == State::Length ? State::Done : State::ChunkDataEnd;
+                }
+                return pos + take;
+            }
+
+            case State::ChunkSize:
+            {
+                int digit = hexValue(c);
+                if (digit >= 0)
+                {
+                    if (remaining > (UINT64_MAX >> 4))
+                    {
+                        state = State::Error;
+                        return pos;
+                    }
+                    remaining = (remaining << 4) | digit;
+                    sizeDigits = true;
+                }
+                else if (!sizeDigits)
+                {
+                    state = State::Error;
+                    return pos;
+                }
+                else if (c == ';' || c == ' ' || c == '\t')
+                {
+                    state = State::ChunkExtension;
+                }
+                else if (c == '\r')
+                {
+                    state = State::ChunkSizeEnd;
+                }
+                else if (c == '\n')
+                {
+                    state = remaining > 0 ? State::ChunkData : State::Trailer;
+                    lineEmpty = true;
+                }
+                else
+                {
+                    state = State::Error;
+                    return pos;
+                }
+                ++pos;
+                break;
+            }
+
+            case State::ChunkExtension:
+                if (c == '\n')
+                {
+                    state = remaining > 0 ? State::ChunkData : State::Trailer;
+                    lineEmpty = true;
+                }
+                ++pos;
+                break;
+
+            case State::ChunkSizeEnd:
+                if (c != '\n')
+                {
+                    state = State::Error;
+                    return pos;
+                }
+                state = remaining > 0 ? State::ChunkData : State::Trailer;
+                lineEmpty = true;
+                ++pos;
+                break;
+
+            case State::ChunkDataEnd:
+                /* Exactly CRLF after the chunk data; anything else would let the framing be read two ways */
+                if (c != '\r')
+                {
+                    state = State::Error;
+                    return pos;
+                }
+                state = State::ChunkDataLf;
+                ++pos;
+                break;
+
+            case State::ChunkDataLf:
+                if (c != '\n')
+                {
+                    state = State::Error;
+                    return pos;
+                }
+                state = State::ChunkSize;
+                sizeDigits = false;
+                ++pos;
+                break;
+
+            case State::Trailer:
+                /* Trailer fields are skipped; the body ends at the first empty line */
+                if (c == '\n')
+                {
+                    if (lineEmpty)
+                    {
+                        state = State::Done;
+                        return pos + 1;
+                    }
+                    lineEmpty = true;
+                }
+                else if (c != '\r')
+                {
+                    lineEmpty = false;
+                }
+                ++pos;
+                break;
+        }
+    }
+    return pos;
+}
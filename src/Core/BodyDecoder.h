@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Incremental request body framing: Content-Length or Transfer-Encoding:
+ * chunked. next() is fed whatever input is buffered and hands back the next
+ * run of body bytes as a view into that input, so data can be passed on or
+ * copied exactly once.
+ */
+class BodyDecoder
+{
+public:
+    void reset();
+    void expectLength(uint64_t length);
+    void expectChunked();
+
+    /* Consumes framing and at most maxData body bytes; returns input bytes consumed */
+    size_t next(std::string_view input, std::string_view& data, size_t maxData = SIZE_MAX);
+
+    bool done() const { return state == State::Done; }
+    bool failed() const { return state == State::Error; }
+    uint64_t decoded() const { return total; }
+
+private:
+    enum class State
+    {
+        Done,
+        Length,
+        ChunkSize,
+        ChunkExtension,
+        ChunkSizeEnd,
+        ChunkData,
+        ChunkDataEnd,
+        ChunkDataLf,
+        Trailer,
+        Error
+    };
+
+    State state = State::Done;
+    uint64_t remaining = 0;
+    uint64_t total = 0;
+    bool sizeDigits = false;
+    bool lineEmpty = true;
+};
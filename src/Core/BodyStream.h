@@ -0,0 +1,50 @@
+#pragma once
+
+#include <coroutine>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+/*
+ * Body of a request whose route was registered with streamBody. The event
+ * loop feeds it as it arrives: to onData/onEnd once a sync handler has
+ * returned (callbacks run on the loop thread and see views into the read
+ * buffer), or chunk by chunk to a coroutine awaiting read().
+ */
+class BodyStream
+{
+public:
+    using DataCallback = std::function<void(std::string_view)>;
+    using EndCallback = std::function<void()>;
+    using ReadHook = std::function<void(std::coroutine_handle<>)>;
+
+    class ReadAwaiter
+    {
+    public:
+        ReadAwaiter(BodyStream* stream, std::string_view immediate)
+            : stream(stream), immediate(immediate)
+        {
+        }
+
+        bool await_ready() const noexcept { return !stream || stream->ended; }
+        void await_suspend(std::coroutine_handle<> handle) { stream->requestRead(handle); }
+        std::string_view await_resume() const { return stream ? std::string_view(stream->chunk) : immediate; }
+
+    private:
+        BodyStream* stream;
+        std::string_view immediate;
+    };
+
+    explicit BodyStream(std::pmr::memory_resource* resource) : chunk(resource) {}
+
+    DataCallback dataCallback;
+    EndCallback endCallback;
+    ReadHook requestRead;
+
+    std::pmr::string chunk;                 /* Last chunk handed to read() */
+    std::coroutine_handle<> pendingRead;    /* Coroutine waiting in read() */
+    bool flowing = false;                   /* Handler returned; push data to the callbacks */
+    bool complete = false;                  /* Loop side: the whole body has been decoded */
+    bool ended = false;                     /* Handler side: no more data will be delivered */
+};
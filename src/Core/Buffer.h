@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+ * Immutable bytes shared by reference count. One serialized message can be
+ * queued on any number of connections; each holds a reference until its copy
+ * of the bytes has been written.
+ */
+class Buffer
+{
+public:
+    explicit Buffer(std::string bytes) : bytes(std::move(bytes)) {}
+
+    static std::shared_ptr<const Buffer> make(std::string bytes) { return std::make_shared<const Buffer>(std::move(bytes)); }
+
+    const char* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    std::string_view view() const { return bytes; }
+
+private:
+    std::string bytes;
+};
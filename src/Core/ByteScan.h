@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Bytes an encoder has to treat specially: up to eight listed bytes, plus
+ * every byte below `below` (0 for none). Meant to be built once as a
+ * constexpr and passed to cleanPrefix().
+ */
+class ByteSet
+{
+public:
+    constexpr ByteSet(std::string_view listed, unsigned char below = 0) : count(0), below(below), bytes{}, table{}
+    {
+        for (char c : listed.substr(0, bytes.size()))
+        {
+            bytes[count++] = c;
+            table[static_cast<unsigned char>(c)] = true;
+        }
+        for (unsigned c = 0; c < below; ++c)
+        {
+            table[c] = true;
+        }
+    }
+
+    constexpr bool contains(char c) const { return table[static_cast<unsigned char>(c)]; }
+
+private:
+    friend size_t cleanPrefix(const char* data, size_t size, const ByteSet& set);
+
+    size_t count;
+    unsigned char below;
+    std::array<char, 8> bytes;
+    std::array<bool, 256> table;
+};
+
+/* Bytes at the front of `data` that are not in `set`, so can be copied as they are; 16 at a time with SSE2 */
+inline size_t
+cleanPrefix(const char* data, size_t size, const ByteSet& set)
+{
+    size_t n = 0;
+#if defined(__SSE2__)
+    __m128i listed[8];
+    for (size_t i = 0; i < set.count; ++i)
+    {
+        listed[i] = _mm_set1_epi8(set.bytes[i]);
+    }
+    const __m128i floor = _mm_set1_epi8(static_cast<char>(set.below - 1));
+    for (; n + 16 <= size; n += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + n));
+        __m128i special = _mm_setzero_si128();
+        for (size_t i = 0; i < set.count; ++i)
+        {
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, listed[i]));
+        }
+        if (set.below > 0)
+        {
+            /* max(c, below - 1) == below - 1 exactly for the unsigned bytes below `below` */
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_max_epu8(chunk, floor), floor));
+        }
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+        {
+            return n + __builtin_ctz(mask);
+        }
+    }
+#endif
+    while (n < size && !set.contains(data[n]))
+    {
+        ++n;
+    }
+    return n;
+}
@@ -0,0 +1,151 @@
+#include "Channel.h"
+
+#include <algorithm>
+#include <iterator>
+#include "Connection.h"
+#include "WebSocket.h"
+
+Channel::Channel(std::string name, size_t maxBacklog, Poster post, Waker wake)
+    : name(std::move(name)), maxBacklog(maxBacklog), post(std::move(post)), wake(std::move(wake)),
+      slowPolicy(SlowPolicy::Drop), webSocketCount(0), eventStreamCount(0), dropped(0)
+{
+}
+
+void
+Channel::publish(std::string_view data, std::string_view event)
+{
+    /* Serialized here, once, and only in the formats someone is listening in */
+    std::shared_ptr<const Buffer> frame;
+    std::shared_ptr<const Buffer> message;
+    if (webSocketCount.load(std::memory_order_relaxed) > 0)
+    {
+        frame = Buffer::make(WebSocket::frame(WebSocket::Text, data));
+    }
+    if (eventStreamCount.load(std::memory_order_relaxed) > 0)
+    {
+        message = Buffer::make(eventStreamMessage(data, event));
+    }
+    if (!frame && !message)
+    {
+        return;
+    }
+
+    post([this, frame = std::move(frame), message = std::move(message)]
+    {
+        deliver(frame, message);
+    });
+}
+
+void
+Channel::subscribe(const std::shared_ptr<WebSocket>& socket)
+{
+    post([this, socket]
+    {
+        if (socket->connection && socket->isOpen())
+        {
+            add(socket->connection);
+        }
+    });
+}
+
+void
+Channel::unsubscribe(const std::shared_ptr<WebSocket>& socket)
+{
+    post([this, socket]
+    {
+        if (socket->connection)
+        {
+            remove(socket->connection);
+        }
+    });
+}
+
+std::string
+Channel::eventStreamMessage(std::string_view data, std::string_view event)
+{
+    /* Every line of the data gets its own field; a blank line ends the event. SSE ends lines at CRLF, CR or LF */
+    std::string message;
+    message.reserve(data.size() + event.size() + 16);
+    if (!event.empty())
+    {
+        /* The event type is one line; breaks in it are dropped so it can't start fields of its own */
+        message.append("event: ");
+        std::remove_copy_if(event.begin(), event.end(), std::back_inserter(message),
+                            [](char c) { return c == '\r' || c == '\n'; });
+        message.append("\n");
+    }
+    while (true)
+    {
+        size_t lineEnd = data.find_first_of("\r\n");
+        message.append("data: ").append(data.substr(0, lineEnd)).append("\n");
+        if (lineEnd == std::string_view::npos)
+        {
+            break;
+        }
+        bool crlf = data[lineEnd] == '\r' && lineEnd + 1 < data.size() && data[lineEnd + 1] == '\n';
+        data.remove_prefix(lineEnd + (crlf ? 2 : 1));
+    }
+    message.append("\n");
+    return message;
+}
+
+void
+Channel::add(Connection* connection)
+{
+    if (std::find(connection->channels.begin(), connection->channels.end(), this) != connection->channels.end())
+    {
+        return;
+    }
+    connection->channels.push_back(this);
+    subscribers.push_back(connection);
+    (connection->webSocket ? webSocketCount : eventStreamCount).fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+Channel::remove(Connection* connection)
+{
+    auto channel = std::find(connection->channels.begin(), connection->channels.end(), this);
+    if (channel == connection->channels.end())
+    {
+        return;
+    }
+    connection->channels.erase(channel);
+
+    /* Order among subscribers doesn't matter, so swap the last one in */
+    auto it = std::find(subscribers.begin(), subscribers.end(), connection);
+    *it = subscribers.back();
+    subscribers.pop_back();
+    (connection->webSocket ? webSocketCount : eventStreamCount).fetch_sub(1, std::memory_order_relaxed);
+}
+
+void
+Channel::deliver(const std::shared_ptr<const Buffer>& frame, const std::shared_ptr<const Buffer>& message)
+{
+    /* Waking a connection may close it and shrink `subscribers`, so walk a snapshot */
+    fanOut.assign(subscribers.begin(), subscribers.end());
+    SlowPolicy policy = slowPolicy.load(std::memory_order_relaxed);
+
+    for (Connection* connection : fanOut)
+    {
+        const std::shared_ptr<const Buffer>& buffer = connection->webSocket ? frame : message;
+        if (!buffer || connection->closeAfterWrite)
+        {
+            continue;
+        }
+
+        if (connection->outputSize() > maxBacklog)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            if (policy == SlowPolicy::Disconnect)
+            {
+                connection->broken = true;
+                wake(connection);
+            }
+            continue;
+        }
+
+        connection->queue(buffer);
+        wake(connection);
+    }
+    fanOut.clear();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Buffer.h"
+
+class Connection;
+class WebSocket;
+
+/*
+ * Named publish/subscribe channel for WebSocket and server-sent event
+ * subscribers. publish() serializes a message once per wire format, as a
+ * WebSocket text frame and as an SSE event, and the event loop queues that
+ * same Buffer on every subscriber's connection without copying it.
+ *
+ * A subscriber whose unwritten output is over the limit is slow: its copy of
+ * the message is dropped, or with SlowPolicy::Disconnect the connection is
+ * closed.
+ */
+class Channel
+{
+public:
+    enum class SlowPolicy : uint8_t
+    {
+        Drop,
+        Disconnect
+    };
+
+    /* Installed by the App: runs `task` on the event loop thread */
+    using Poster = std::function<void(std::function<void()> task)>;
+    /* Installed by the App: writes out what was queued on a connection */
+    using Waker = std::function<void(Connection* connection)>;
+
+    Channel(std::string name, size_t maxBacklog, Poster post, Waker wake);
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    /* Thread-safe. `event` sets the SSE event type; WebSocket subscribers get `data` only */
+    void publish(std::string_view data, std::string_view event = {});
+    /* Thread-safe; a closed socket leaves its channels by itself */
+    void subscribe(const std::shared_ptr<WebSocket>& socket);
+    void unsubscribe(const std::shared_ptr<WebSocket>& socket);
+
+    void setSlowPolicy(SlowPolicy policy) { slowPolicy.store(policy, std::memory_order_relaxed); }
+    size_t subscriberCount() const { return webSocketCount.load(std::memory_order_relaxed) + eventStreamCount.load(std::memory_order_relaxed); }
+    /* Messages not queued for a slow subscriber, summed over subscribers */
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    /* text/event-stream framing of one message */
+    static std::string eventStreamMessage(std::string_view data, std::string_view event);
+
+public:
+    const std::string name;
+
+    /* Loop thread only */
+    void add(Connection* connection);
+    void remove(Connection* connection);
+
+private:
+    size_t maxBacklog;
+    Poster post;
+    Waker wake;
+    std::atomic<SlowPolicy> slowPolicy;
+    std::atomic<size_t> webSocketCount;
+    std::atomic<size_t> eventStreamCount;
+    std::atomic<uint64_t> dropped;
+
+    std::vector<Connection*> subscribers;   /* Loop thread only */
+    std::vector<Connection*> fanOut;        /* Reused snapshot of `subscribers` */
+
+    void deliver(const std::shared_ptr<const Buffer>& frame, const std::shared_ptr<const Buffer>& event);
+};
@@ -0,0 +1,196 @@
+#include "Compression.h"
+
+#include <charconv>
+#include <zlib.h>
+#include "Headers.h"
+
+namespace
+{
+    std::string_view trim(std::string_view str)
+    {
+        size_t start = str.find_first_not_of(" \t");
+        if (start == std::string_view::npos)
+        {
+            return {};
+        }
+        size_t end = str.find_last_not_of(" \t");
+        return str.substr(start, end - start + 1);
+    }
+
+    /* q-value of one Accept-Encoding element's parameters; 1 when absent */
+    float qualityOf(std::string_view parameters)
+    {
+        while (!parameters.empty())
+        {
+            size_t semicolon = parameters.find(';');
+            std::string_view parameter = trim(parameters.substr(0, semicolon));
+            parameters.remove_prefix(semicolon == std::string_view::npos ? parameters.size() : semicolon + 1);
+
+            if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=')
+            {
+                float quality = 0;
+                auto result = std::from_chars(parameter.data() + 2, parameter.data() + parameter.size(), quality);
+                return result.ec == std::errc() ? quality : 0;
+            }
+        }
+        return 1;
+    }
+
+    bool startsWithIgnoreCase(std::string_view str, std::string_view prefix)
+    {
+        return str.size() >= prefix.size() && equalsIgnoreCase(str.substr(0, prefix.size()), prefix);
+    }
+
+    constexpr std::string_view COMPRESSED_TYPES[] = {
+        "application/zip", "application/gzip", "application/x-gzip", "application/x-bzip2", "application/x-xz",
+        "application/zstd", "application/x-7z-compressed", "application/x-rar-compressed", "application/pdf",
+        "font/woff", "font/woff2"
+    };
+
+    /* One coding's deflate stream, set up on first use and reset between bodies */
+    class Deflater
+    {
+    public:
+        explicit Deflater(int windowOffset) : windowOffset(windowOffset) {}
+
+        ~Deflater()
+        {
+            if (ready)
+            {
+                deflateEnd(&stream);
+            }
+        }
+
+        z_stream* get(const CompressionOptions& options)
+        {
+            bool changed = level != options.level || memLevel != options.memLevel || windowBits != options.windowBits;
+            if (ready && changed)
+            {
+                deflateEnd(&stream);
+                ready = false;
+            }
+            if (ready)
+            {
+                deflateReset(&stream);
+                return &stream;
+            }
+
+            stream = z_stream{};
+            if (deflateInit2(&stream, options.level, Z_DEFLATED, options.windowBits + windowOffset, options.memLevel,
+                             Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                return nullptr;
+            }
+            ready = true;
+            level = options.level;
+            memLevel = options.memLevel;
+            windowBits = options.windowBits;
+            return &stream;
+        }
+
+    private:
+        z_stream stream{};
+        int windowOffset;       /* 16 asks zlib for a gzip wrapper, 0 for the zlib one "deflate" means */
+        bool ready = false;
+        int level = 0;
+        int memLevel = 0;
+        int windowBits = 0;
+    };
+
+    thread_local Deflater gzipDeflater(16);
+    thread_local Deflater zlibDeflater(0);
+}
+
+ContentEncoding
+negotiateEncoding(std::string_view acceptEncoding)
+{
+    float gzip = -1;
+    float deflate = -1;
+    float any = -1;
+    while (!acceptEncoding.empty())
+    {
+        size_t comma = acceptEncoding.find(',');
+        std::string_view element = acceptEncoding.substr(0, comma);
+        acceptEncoding.remove_prefix(comma == std::string_view::npos ? acceptEncoding.size() : comma + 1);
+
+        size_t semicolon = element.find(';');
+        std::string_view coding = trim(element.substr(0, semicolon));
+        float quality = semicolon == std::string_view::npos ? 1 : qualityOf(element.substr(semicolon + 1));
+        if (equalsIgnoreCase(coding, "gzip") || equalsIgnoreCase(coding, "x-gzip"))
+        {
+            gzip = quality;
+        }
+        else if (equalsIgnoreCase(coding, "deflate"))
+        {
+            deflate = quality;
+        }
+        else if (coding == "*")
+        {
+            any = quality;
+        }
+    }
+
+    /* "*" covers the codings not named; q=0 rules one out */
+    gzip = gzip < 0 ? any : gzip;
+    deflate = deflate < 0 ? any : deflate;
+    if (gzip > 0 && gzip >= deflate)
+    {
+        return ContentEncoding::Gzip;
+    }
+    return deflate > 0 ? ContentEncoding::Deflate : ContentEncoding::Identity;
+}
+
+bool
+isCompressible(std::string_view contentType, size_t size, const CompressionOptions& options)
+{
+    if (size < options.minSize)
+    {
+        return false;
+    }
+    contentType = trim(contentType.substr(0, contentType.find(';')));
+    if (startsWithIgnoreCase(contentType, "image/"))
+    {
+        return equalsIgnoreCase(contentType, "image/svg+xml");
+    }
+    if (startsWithIgnoreCase(contentType, "audio/") || startsWithIgnoreCase(contentType, "video/"))
+    {
+        return false;
+    }
+    for (std::string_view type : COMPRESSED_TYPES)
+    {
+        if (equalsIgnoreCase(contentType, type))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+compressBody(std::string_view body, std::pmr::string& compressed, ContentEncoding encoding,
+             const CompressionOptions& options)
+{
+    if (encoding == ContentEncoding::Identity || body.size() > UINT32_MAX)
+    {
+        return false;
+    }
+    z_stream* stream = (encoding == ContentEncoding::Gzip ? gzipDeflater : zlibDeflater).get(options);
+    if (!stream)
+    {
+        return false;
+    }
+
+    /* One deflate() call into a buffer of the worst-case size */
+    compressed.resize(deflateBound(stream, static_cast<uLong>(body.size())));
+    stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream->avail_in = static_cast<uInt>(body.size());
+    stream->next_out = reinterpret_cast<Bytef*>(compressed.data());
+    stream->avail_out = static_cast<uInt>(compressed.size());
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END || stream->total_out >= body.size())
+    {
+        return false;
+    }
+
+    compressed.resize(stream->total_out);
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+/* zlib settings for compressed responses */
+struct CompressionOptions
+{
+    int level = 6;              /* 1 (fastest) to 9 (smallest) */
+    int memLevel = 8;           /* 1 to 9: deflate state memory against ratio */
+    int windowBits = 15;        /* 9 to 15: history window of 2^windowBits bytes */
+    size_t minSize = 1024;      /* Smaller bodies are sent as they are */
+};
+
+enum class ContentEncoding : uint8_t
+{
+    Identity,
+    Gzip,
+    Deflate
+};
+
+/* The coding Accept-Encoding prefers among gzip and deflate, honouring q-values and "*" */
+ContentEncoding negotiateEncoding(std::string_view acceptEncoding);
+
+/* Skips small bodies and media types that are compressed already (images, audio, video, archives, fonts) */
+bool isCompressible(std::string_view contentType, size_t size, const CompressionOptions& options);
+
+/*
+ * Compresses `body` into `compressed`. Each thread keeps one deflate stream
+ * per coding and resets it between bodies rather than allocating a new one
+ * every time. Returns false if compression fails or doesn't make the body
+ * smaller.
+ */
+bool compressBody(std::string_view body, std::pmr::string& compressed, ContentEncoding encoding,
+                  const CompressionOptions& options);
@@ -0,0 +1,333 @@
+#include "Connection.h"
+#include "Http2.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace
+{
+    constexpr size_t INITIAL_INPUT = 4096;
+    constexpr size_t MAX_IOVECS = 64;
+    /* Below this, pinning pages and handling the completion costs more than the copy it saves */
+    constexpr size_t ZERO_COPY_MIN = 64 * 1024;
+}
+
+Connection::Connection(int fd)
+    : fd(fd), interest(0), inFlight(0), peerClosed(false), closeAfterWrite(false), broken(false),
+      reading(nullptr), batchRunning(false), eventStream(false),
+      inputStart(0), inputEnd(0), outputOffset(0), outputBytes(0),
+      zeroCopyTried(false), zeroCopy(false), zeroCopySends(0), zeroCopyDone(0)
+{
+}
+
+Connection::~Connection()
+{
+    /* Exchanges the session still holds go first; the ones being written are released below */
+    http2.reset();
+
+    /* A streamed body's exchange is also in parsed or batch */
+    if (reading && !reading->req.stream)
+    {
+        reading->release();
+    }
+    for (Exchange* exchange : parsed)
+    {
+        exchange->release();
+    }
+    for (Exchange* exchange : batch)
+    {
+        exchange->release();
+    }
+    for (Segment& segment : output)
+    {
+        if (segment.owner)
+        {
+            segment.owner->release();
+        }
+    }
+    /* Only a broken socket is closed with sends in flight, and it drops them */
+    for (Pinned& body : pinned)
+    {
+        body.owner->release();
+    }
+    close(fd);
+}
+
+bool
+Connection::readAvailable(size_t maxBuffered)
+{
+    while (true)
+    {
+        /* Reclaim what has been parsed before growing */
+        if (inputStart > 0 && inputEnd == input.size())
+        {
+            std::memmove(input.data(), input.data() + inputStart, inputEnd - inputStart);
+            inputEnd -= inputStart;
+            inputStart = 0;
+        }
+
+        if (inputEnd == input.size())
+        {
+            if (input.size() >= maxBuffered)
+            {
+                return true;
+            }
+            input.resize(std::min(maxBuffered, std::max(INITIAL_INPUT, input.size() * 2)));
+        }
+
+        ssize_t bytesRead = ::read(fd, input.data() + inputEnd, input.size() - inputEnd);
+        if (bytesRead > 0)
+        {
+            inputEnd += bytesRead;
+            continue;
+        }
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return true;
+        }
+        if (bytesRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        peerClosed = true;
+        return false;
+    }
+}
+
+std::string_view
+Connection::unparsed() const
+{
+    return std::string_view(input.data() + inputStart, inputEnd - inputStart);
+}
+
+void
+Connection::consume(size_t bytes)
+{
+    inputStart += bytes;
+    if (inputStart == inputEnd)
+    {
+        inputStart = 0;
+        inputEnd = 0;
+    }
+}
+
+void
+Connection::queue(const char* data, size_t size, Exchange* owner)
+{
+    output.push_back(Segment{data, size, owner, {}, {}});
+    outputBytes += size;
+}
+
+void
+Connection::queue(std::string bytes)
+{
+    Segment& segment = output.emplace_back(Segment{nullptr, 0, nullptr, std::move(bytes), {}});
+    segment.data = segment.owned.data();
+    segment.size = segment.owned.size();
+    outputBytes += segment.size;
+}
+
+void
+Connection::queue(Exchange* exchange)
+{
+    if (exchange->wireBody.empty())
+    {
+        queue(exchange->wire.data(), exchange->wire.size(), exchange);
+        return;
+    }
+    queue(exchange->wire.data(), exchange->wire.size());
+    queue(exchange->wireBody.data(), exchange->wireBody.size(), exchange);
+
+    if (exchange->wireBody.size() >= ZERO_COPY_MIN && !zeroCopyTried)
+    {
+        zeroCopyTried = true;
+        int on = 1;
+        zeroCopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+    }
+    output.back().zeroCopy = zeroCopy && exchange->wireBody.size() >= ZERO_COPY_MIN;
+}
+
+void
+Connection::queue(std::shared_ptr<const Buffer> buffer)
+{
+    const char* data = buffer->data();
+    size_t size = buffer->size();
+    output.push_back(Segment{data, size, nullptr, {}, std::move(buffer)});
+    outputBytes += size;
+}
+
+void
+Connection::releaseInput()
+{
+    if (inputStart == inputEnd && !input.empty())
+    {
+        std::vector<char>().swap(input);
+        inputStart = 0;
+        inputEnd = 0;
+    }
+}
+
+bool
+Connection::flush()
+{
+    while (!output.empty())
+    {
+        /* A zero-copy segment is sent on its own, so nothing else gets pinned with it */
+        bool zeroCopySend = output.front().zeroCopy && zeroCopy;
+        iovec iov[MAX_IOVECS];
+        size_t count = 0;
+        size_t total = 0;
+        for (auto it = output.begin(); it != output.end() && count < MAX_IOVECS; ++it, ++count)
+        {
+            if (count > 0 && (zeroCopySend || (zeroCopy && it->zeroCopy)))
+            {
+                break;
+            }
+            size_t skip = count == 0 ? outputOffset : 0;
+            iov[count].iov_base = const_cast<char*>(it->data + skip);
+            iov[count].iov_len = it->size - skip;
+            total += iov[count].iov_len;
+        }
+
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL | (zeroCopySend ? MSG_ZEROCOPY : 0));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == ENOBUFS && zeroCopySend)
+            {
+                /* Over the limit of pinned memory: this part is copied */
+                output.front().zeroCopy = false;
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (zeroCopySend)
+        {
+            output.front().zeroCopySend = zeroCopySends++;
+        }
+
+        outputBytes -= written;
+        size_t remaining = written;
+        while (!output.empty() && remaining >= output.front().size - outputOffset)
+        {
+            remaining -= output.front().size - outputOffset;
+            outputOffset = 0;
+            releaseFinished(output.front());
+            output.pop_front();
+        }
+        outputOffset += remaining;
+
+        if (static_cast<size_t>(written) < total)
+        {
+            /* Short write: the socket buffer is full */
+            return true;
+        }
+    }
+    return true;
+}
+
+bool
+Connection::reapZeroCopy()
+{
+    if (!zeroCopyTried)
+    {
+        return false;
+    }
+    while (true)
+    {
+        char control[128];
+        msghdr message{};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &message, MSG_ERRQUEUE) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+        {
+            bool recvErr = (header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR)
+                || (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR);
+            sock_extended_err error;
+            std::memcpy(&error, CMSG_DATA(header), sizeof(error));
+            if (!recvErr || error.ee_errno != 0 || error.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                /* The kernel copied after all (loopback, no scatter-gather); pinning only adds cost from here on */
+                zeroCopy = false;
+            }
+            completeZeroCopy(error.ee_info, error.ee_data);
+        }
+    }
+
+    int socketError = 0;
+    socklen_t length = sizeof(socketError);
+    return getsockopt(fd, SOL_SOCKET, SO_ERROR, &socketError, &length) == 0 && socketError == 0;
+}
+
+void
+Connection::completeZeroCopy(uint32_t first, uint32_t last)
+{
+    /* TCP reports sends in order, but nothing is released past a gap */
+    zeroCopyEarly.emplace_back(first, last);
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (auto it = zeroCopyEarly.begin(); it != zeroCopyEarly.end(); ++it)
+        {
+            if (static_cast<int32_t>(it->first - zeroCopyDone) <= 0)
+            {
+                if (static_cast<int32_t>(it->second + 1 - zeroCopyDone) > 0)
+                {
+                    zeroCopyDone = it->second + 1;
+                }
+                zeroCopyEarly.erase(it);
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    while (!pinned.empty() && static_cast<int32_t>(pinned.front().send - zeroCopyDone) < 0)
+    {
+        pinned.front().owner->release();
+        pinned.pop_front();
+        --inFlight;
+    }
+}
+
+void
+Connection::releaseFinished(Segment& segment)
+{
+    if (!segment.owner)
+    {
+        return;
+    }
+    if (segment.zeroCopySend >= 0)
+    {
+        pinned.push_back(Pinned{static_cast<uint32_t>(segment.zeroCopySend), segment.owner});
+        return;
+    }
+    segment.owner->release();
+    --inFlight;
+}
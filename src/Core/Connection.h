@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BodyDecoder.h"
+#include "Buffer.h"
+#include "HeadParser.h"
+#include "Exchange.h"
+
+class Channel;
+class Http2Session;
+class WebSocket;
+
+/*
+ * A client socket owned by the event loop thread. It buffers what has been
+ * read but not yet parsed, the pipelined exchanges in flight, and the output
+ * waiting to be written. Only the loop thread touches it, except `batch`,
+ * which belongs to the workers while `batchRunning` is set.
+ */
+class Connection
+{
+public:
+    explicit Connection(int fd);
+    ~Connection();
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    /* Reads until the socket is drained or `input` holds maxBuffered bytes; false once the peer is gone */
+    bool readAvailable(size_t maxBuffered);
+    std::string_view unparsed() const;
+    void consume(size_t bytes);
+
+    /* Queues bytes for writing; `owner` is released once they are all sent */
+    void queue(const char* data, size_t size, Exchange* owner = nullptr);
+    /* Queues bytes the connection keeps until they are sent */
+    void queue(std::string bytes);
+    /*
+     * Queues the response of `exchange`, `wire` then `wireBody`, and releases
+     * the exchange once it is sent. A large `wireBody` is sent with
+     * MSG_ZEROCOPY; the exchange is then kept until the kernel reports that
+     * it no longer reads from the body.
+     */
+    void queue(Exchange* exchange);
+    /* Queues a shared buffer; the reference is dropped once it is sent */
+    void queue(std::shared_ptr<const Buffer> buffer);
+    /* Writes as much as possible in one writev per call; false on a write error */
+    bool flush();
+    bool hasOutput() const { return !output.empty(); }
+    /* Some sent body may still be read by the kernel; the connection must not be closed yet */
+    bool awaitingZeroCopy() const { return !pinned.empty(); }
+    /* Takes zero-copy completions off the socket's error queue; false if the error was a real one */
+    bool reapZeroCopy();
+    size_t outputSize() const { return outputBytes; }
+    /* Frees the read buffer once everything in it has been parsed, so idle connections stay small */
+    void releaseInput();
+
+public:
+    int fd;
+    uint32_t interest;
+    size_t inFlight;    /* Exchanges parsed and not yet released */
+    bool peerClosed;
+    bool closeAfterWrite;
+    bool broken;                /* Socket error; close as soon as no batch is running */
+    std::string_view rejection; /* Static error response to send after the in-flight ones */
+
+    HeadParser headParser;      /* Head of the next request, scanned as it arrives */
+    Exchange* reading;          /* Exchange whose body is still arriving */
+    BodyDecoder decoder;
+
+    std::deque<Exchange*> parsed;
+    std::vector<Exchange*> batch;
+    bool batchRunning;
+
+    /* Set once the connection has switched to HTTP/2; it then owns framing */
+    std::unique_ptr<Http2Session> http2;
+    /* Set by a WebSocket handshake; once its `connection` is set the input is frames */
+    std::shared_ptr<WebSocket> webSocket;
+    bool eventStream;                   /* Sending server-sent events; input is ignored */
+    std::vector<Channel*> channels;     /* Channels this connection is subscribed to */
+
+private:
+    struct Segment
+    {
+        const char* data;
+        size_t size;
+        Exchange* owner;
+        std::string owned;
+        std::shared_ptr<const Buffer> shared;
+        bool zeroCopy = false;          /* Sent with MSG_ZEROCOPY while the socket allows it */
+        int64_t zeroCopySend = -1;      /* Last zero-copy send that carried some of it */
+    };
+
+    /* An exchange whose body went out by zero-copy send number `send` or earlier */
+    struct Pinned
+    {
+        uint32_t send;
+        Exchange* owner;
+    };
+
+    std::vector<char> input;
+    size_t inputStart;
+    size_t inputEnd;
+
+    std::deque<Segment> output;
+    size_t outputOffset;
+    size_t outputBytes;
+
+    bool zeroCopyTried;     /* SO_ZEROCOPY was requested */
+    bool zeroCopy;          /* ... and granted, and the kernel hasn't been copying anyway */
+    uint32_t zeroCopySends;
+    uint32_t zeroCopyDone;  /* Sends 0 to zeroCopyDone - 1 are complete */
+    std::vector<std::pair<uint32_t, uint32_t>> zeroCopyEarly;   /* Completed ranges past a gap */
+    std::deque<Pinned> pinned;
+
+    void completeZeroCopy(uint32_t first, uint32_t last);
+    void releaseFinished(Segment& segment);
+};
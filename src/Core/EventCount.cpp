@@ -0,0 +1,55 @@
+#include "EventCount.h"
+
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+EventCount::Key
+EventCount::prepareWait()
+{
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    return epoch.load(std::memory_order_seq_cst);
+}
+
+void
+EventCount::cancelWait()
+{
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void
+EventCount::commitWait(Key key)
+{
+    while (epoch.load(std::memory_order_acquire) == key)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+    }
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void
+EventCount::notifyOne()
+{
+    notify(1);
+}
+
+void
+EventCount::notifyAll()
+{
+    notify(INT_MAX);
+}
+
+void
+EventCount::notify(int count)
+{
+    /* Pairs with prepareWait: either we see the waiter or it sees the producer's state change */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) == 0)
+    {
+        return;
+    }
+
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Futex-backed eventcount. A waiter announces itself with prepareWait(),
+ * re-checks its condition, then either cancelWait()s or commitWait()s with
+ * the returned key. A notify() issued after prepareWait() changes the epoch,
+ * so commitWait() returns at once and no wakeup is lost.
+ */
+class EventCount
+{
+public:
+    using Key = uint32_t;
+
+    Key prepareWait();
+    void cancelWait();
+    void commitWait(Key key);
+
+    void notifyOne();
+    void notifyAll();
+
+private:
+    std::atomic<uint32_t> epoch{0};
+    std::atomic<uint32_t> waiters{0};
+
+    void notify(int count);
+};
@@ -0,0 +1,286 @@
+#include "EventLoop.h"
+
+#include <iostream>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+EventLoop::EventLoop()
+    : epollFd(epoll_create1(EPOLL_CLOEXEC)), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      running(false), timerSequence(0)
+{
+    if (epollFd < 0 || wakeFd < 0)
+    {
+        std::cerr << "Could not create event loop\n";
+        return;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+EventLoop::~EventLoop()
+{
+    stop();
+    close(wakeFd);
+    close(epollFd);
+}
+
+void
+EventLoop::start()
+{
+    if (running.exchange(true))
+    {
+        return;
+    }
+    thread = std::thread([this] { run(); });
+}
+
+void
+EventLoop::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    wake();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void
+EventLoop::post(Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        posted.push_back(std::move(callback));
+    }
+    wake();
+}
+
+void
+EventLoop::watch(int fd, uint32_t events, Callback callback)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Waiter>& waiting = watchers[fd];
+    waiting.push_back(Waiter{events, std::move(callback)});
+
+    if (!arm(fd, waiting))
+    {
+        /* Not pollable (e.g. a regular file): it is always ready, fire on the next iteration */
+        for (Waiter& waiter : waiting)
+        {
+            posted.push_back(std::move(waiter.callback));
+        }
+        watchers.erase(fd);
+        wake();
+    }
+}
+
+bool
+EventLoop::arm(int fd, const std::vector<Waiter>& waiting)
+{
+    /* One registration per fd, listening for what any of its waiters wants */
+    epoll_event event{};
+    event.events = EPOLLONESHOT;
+    event.data.fd = fd;
+    for (const Waiter& waiter : waiting)
+    {
+        event.events |= waiter.events;
+    }
+
+    /* A one-shot fd stays registered after it fired, so re-arm before trying to add it */
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0
+        || (errno == ENOENT && epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0);
+}
+
+void
+EventLoop::add(int fd, uint32_t events, Handler handler)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    handlers[fd] = std::make_shared<Handler>(std::move(handler));
+
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        std::cerr << "Could not watch fd " << fd << "\n";
+        handlers.erase(fd);
+    }
+}
+
+void
+EventLoop::modify(int fd, uint32_t events)
+{
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void
+EventLoop::remove(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    handlers.erase(fd);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void
+EventLoop::setTimeout(std::chrono::milliseconds delay, Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timers.push(Timer{Clock::now() + delay, timerSequence++, std::move(callback)});
+    }
+    wake();
+}
+
+void
+EventLoop::wake()
+{
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = write(wakeFd, &one, sizeof(one));
+}
+
+int
+EventLoop::nextTimeout()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!posted.empty())
+    {
+        return 0;
+    }
+    if (timers.empty())
+    {
+        return -1;
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(timers.top().deadline - Clock::now());
+    return remaining.count() > 0 ? static_cast<int>(remaining.count()) + 1 : 0;
+}
+
+void
+EventLoop::runTimers()
+{
+    std::vector<Callback> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = Clock::now();
+        while (!timers.empty() && timers.top().deadline <= now)
+        {
+            expired.push_back(std::move(const_cast<Timer&>(timers.top()).callback));
+            timers.pop();
+        }
+    }
+
+    for (Callback& callback : expired)
+    {
+        callback();
+    }
+}
+
+void
+EventLoop::runPosted()
+{
+    std::vector<Callback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        callbacks.swap(posted);
+    }
+
+    for (Callback& callback : callbacks)
+    {
+        callback();
+    }
+}
+
+void
+EventLoop::run()
+{
+    constexpr int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+
+    while (running)
+    {
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, nextTimeout());
+        if (count < 0 && errno != EINTR)
+        {
+            std::cerr << "epoll_wait failed\n";
+            break;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd)
+            {
+                uint64_t value;
+                [[maybe_unused]] ssize_t n = read(wakeFd, &value, sizeof(value));
+                continue;
+            }
+
+            std::vector<Callback> ready;
+            std::shared_ptr<Handler> handler;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = watchers.find(fd);
+                if (it != watchers.end())
+                {
+                    /* Errors and hangups wake every waiter; the others keep waiting for their direction */
+                    uint32_t fired = events[i].events;
+                    std::vector<Waiter>& waiting = it->second;
+                    std::erase_if(waiting, [&ready, fired](Waiter& waiter)
+                    {
+                        if (!(fired & (waiter.events | EPOLLERR | EPOLLHUP)))
+                        {
+                            return false;
+                        }
+                        ready.push_back(std::move(waiter.callback));
+                        return true;
+                    });
+                    if (waiting.empty())
+                    {
+                        watchers.erase(it);
+                    }
+                    else if (!arm(fd, waiting))
+                    {
+                        for (Waiter& waiter : waiting)
+                        {
+                            ready.push_back(std::move(waiter.callback));
+                        }
+                        watchers.erase(it);
+                    }
+                }
+                else
+                {
+                    auto registered = handlers.find(fd);
+                    if (registered == handlers.end())
+                    {
+                        continue;
+                    }
+                    /* Keeps the handler alive even if it removes itself */
+                    handler = registered->second;
+                }
+            }
+
+            if (handler)
+            {
+                (*handler)(events[i].events);
+            }
+            for (Callback& callback : ready)
+            {
+                callback();
+            }
+        }
+
+        runTimers();
+        runPosted();
+    }
+}
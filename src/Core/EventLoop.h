@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Single epoll thread that fires readiness, timer and posted callbacks */
+class EventLoop
+{
+public:
+    using Callback = std::function<void()>;
+    using Handler = std::function<void(uint32_t events)>;
+    using Clock = std::chrono::steady_clock;
+
+    EventLoop();
+    ~EventLoop();
+
+    void start();
+    void stop();
+
+    /* Runs callback on the loop thread */
+    void post(Callback callback);
+
+    /*
+     * Runs callback once when fd becomes ready for any of `events` (EPOLLIN / EPOLLOUT).
+     * An fd may have several waiters at once, e.g. one reading and one writing.
+     */
+    void watch(int fd, uint32_t events, Callback callback);
+
+    /* Level-triggered registration that stays until remove(); handler gets the ready events */
+    void add(int fd, uint32_t events, Handler handler);
+    void modify(int fd, uint32_t events);
+    void remove(int fd);
+
+    void setTimeout(std::chrono::milliseconds delay, Callback callback);
+
+private:
+    struct Timer
+    {
+        Clock::time_point deadline;
+        uint64_t sequence;
+        Callback callback;
+
+        bool operator>(const Timer& other) const
+        {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    struct Waiter
+    {
+        uint32_t events;
+        Callback callback;
+    };
+
+    int epollFd;
+    int wakeFd;
+    std::thread thread;
+    std::atomic<bool> running;
+
+    std::mutex mutex;
+    std::vector<Callback> posted;
+    std::unordered_map<int, std::vector<Waiter>> watchers;
+    std::unordered_map<int, std::shared_ptr<Handler>> handlers;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timerSequence;
+
+    void run();
+    void wake();
+    bool arm(int fd, const std::vector<Waiter>& waiting);
+    int nextTimeout();
+    void runTimers();
+    void runPosted();
+};
@@ -0,0 +1,43 @@
+#include "Exchange.h"
+
+namespace
+{
+    template<class Source>
+    Exchange* createInArena(const Source& source)
+    {
+        std::unique_ptr<Arena> arena = Arena::detach();
+        Exchange* exchange = arena->create<Exchange>(source, *arena);
+        exchange->arena = std::move(arena);
+        return exchange;
+    }
+}
+
+Exchange::Exchange(std::string_view httpRequest, Arena& arena)
+    : req(httpRequest, &arena), res(&arena), bodyStream(&arena), wire(&arena), cacheKey(&arena)
+{
+}
+
+Exchange::Exchange(const RequestHead& head, Arena& arena)
+    : req(head, &arena), res(&arena), bodyStream(&arena), wire(&arena), cacheKey(&arena)
+{
+}
+
+Exchange*
+Exchange::create(std::string_view httpRequest)
+{
+    return createInArena(httpRequest);
+}
+
+Exchange*
+Exchange::create(const RequestHead& head)
+{
+    return createInArena(head);
+}
+
+void
+Exchange::release()
+{
+    std::unique_ptr<Arena> ownedArena = std::move(arena);
+    this->~Exchange();
+    Arena::release(std::move(ownedArena));
+}
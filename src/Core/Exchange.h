@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include "Arena.h"
+#include "ReqRes.h"
+#include "Route.h"
+
+class Connection;
+class WebSocket;
+
+/*
+ * One request/response pair, placement-built in its own Arena together with
+ * everything it allocates. It travels from the event loop to the workers and
+ * back, and is released (destroyed, arena returned to the pool) once its
+ * response bytes are on the wire.
+ */
+struct Exchange
+{
+    Exchange(std::string_view httpRequest, Arena& arena);
+    Exchange(const RequestHead& head, Arena& arena);
+
+    static Exchange* create(std::string_view httpRequest);
+    static Exchange* create(const RequestHead& head);
+    void release();
+
+    Request req;
+    Response res;
+    BodyStream bodyStream;  /* Used when the route streams its body */
+    std::pmr::string wire;  /* Serialized response */
+    std::string_view wireBody;  /* Written after `wire` by reference rather than copied into it */
+    std::shared_ptr<const Route> route;
+    Connection* connection = nullptr;
+    size_t batchIndex = 0;
+    uint32_t streamId = 0;  /* HTTP/2 stream, 0 over HTTP/1 */
+    std::shared_ptr<WebSocket> webSocket;   /* Set when the request upgrades to a WebSocket */
+    bool keepAlive = true;
+    std::pmr::string cacheKey;  /* Set when the response may be cached */
+    bool cacheRefresh = false;  /* Re-rendering a stale cache entry; no client waits on it */
+    bool leadsFlight = false;   /* Others wait on this single-flight request's response */
+    bool alone = false;         /* Runs its handler outside single-flight and the cache */
+    bool awaitingContinue = false;  /* Expect: 100-continue not answered yet */
+    std::unique_ptr<Arena> arena;
+};
@@ -0,0 +1,285 @@
+#include "HeadParser.h"
+
+#include <array>
+
+namespace
+{
+    enum CharClass : uint8_t
+    {
+        TOKEN = 1,      /* tchar: methods and field names */
+        TARGET = 2,     /* visible ASCII: request targets */
+        VALUE = 4       /* field-vchar, SP and HTAB: field values */
+    };
+
+    constexpr std::array<uint8_t, 256> makeCharClasses()
+    {
+        std::array<uint8_t, 256> classes{};
+        for (int c = 0x21; c < 0x7F; ++c)
+        {
+            classes[c] |= TARGET | VALUE;
+        }
+        for (int c = 0x80; c < 0x100; ++c)
+        {
+            classes[c] |= VALUE;    /* obs-text */
+        }
+        classes[' '] |= VALUE;
+        classes['\t'] |= VALUE;
+
+        for (int c = '0'; c <= '9'; ++c) classes[c] |= TOKEN;
+        for (int c = 'a'; c <= 'z'; ++c) classes[c] |= TOKEN;
+        for (int c = 'A'; c <= 'Z'; ++c) classes[c] |= TOKEN;
+        for (char c : std::string_view("!#$%&'*+-.^_`|~"))
+        {
+            classes[static_cast<uint8_t>(c)] |= TOKEN;
+        }
+        return classes;
+    }
+
+    constexpr std::array<uint8_t, 256> CHAR_CLASSES = makeCharClasses();
+
+    bool is(char c, CharClass charClass)
+    {
+        return CHAR_CLASSES[static_cast<uint8_t>(c)] & charClass;
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+}
+
+HeadParser::Status
+HeadParser::parse(std::string_view input, const HeadLimits& limits)
+{
+    using enum State;
+
+    /* Nothing past the size limit is looked at */
+    size_t end = input.size() < limits.maxHeaderSize ? input.size() : limits.maxHeaderSize;
+    const char* data = input.data();
+
+    while (pos < end)
+    {
+        char c = data[pos];
+        switch (state)
+        {
+            case Method:
+                if (is(c, TOKEN))
+                {
+                    ++pos;
+                    continue;
+                }
+                if (pos == methodStart && (c == '\r' || c == '\n'))
+                {
+                    /* Stray line breaks between pipelined requests */
+                    methodStart = ++pos;
+                    continue;
+                }
+                if (c != ' ' || pos == methodStart)
+                {
+                    return Status::BadRequest;
+                }
+                targetStart = ++pos;
+                state = Target;
+                continue;
+
+            case Target:
+                while (pos < end && is(data[pos], TARGET))
+                {
+                    ++pos;
+                }
+                if (pos - targetStart > limits.maxUriLength)
+                {
+                    return Status::UriTooLong;
+                }
+                if (pos == end)
+                {
+                    continue;
+                }
+                if (data[pos] != ' ' || pos == targetStart)
+                {
+                    return Status::BadRequest;
+                }
+                versionStart = ++pos;
+                state = Version;
+                continue;
+
+            case Version:
+                if (c == '\r' || c == '\n')
+                {
+                    versionEnd = pos;
+                    Status status = checkVersion(input);
+                    if (status != Status::Complete)
+                    {
+                        return status;
+                    }
+                    ++pos;
+                    state = c == '\r' ? RequestLineEnd : LineStart;
+                    continue;
+                }
+                if (pos - versionStart >= 8 || !is(c, TARGET))
+                {
+                    return Status::BadRequest;
+                }
+                ++pos;
+                continue;
+
+            case RequestLineEnd:
+            case ValueEnd:
+            case HeadEnd:
+                /* CR must be followed by LF */
+                if (c != '\n')
+                {
+                    return Status::BadRequest;
+                }
+                ++pos;
+                if (state == ValueEnd)
+                {
+                    spans.push_back(field);
+                }
+                state = state == HeadEnd ? Done : LineStart;
+                if (state == Done)
+                {
+                    finish(input);
+                    return Status::Complete;
+                }
+                continue;
+
+            case LineStart:
+                if (c == '\r')
+                {
+                    ++pos;
+                    state = HeadEnd;
+                    continue;
+                }
+                if (c == '\n')
+                {
+                    ++pos;
+                    finish(input);
+                    state = Done;
+                    return Status::Complete;
+                }
+                /* Leading whitespace would be obsolete line folding */
+                if (!is(c, TOKEN))
+                {
+                    return Status::BadRequest;
+                }
+                if (spans.size() >= limits.maxHeaderCount)
+                {
+                    return Status::HeadersTooLarge;
+                }
+                field.nameStart = static_cast<uint32_t>(pos++);
+                state = Name;
+                continue;
+
+            case Name:
+                while (pos < end && is(data[pos], TOKEN))
+                {
+                    ++pos;
+                }
+                if (pos == end)
+                {
+                    continue;
+                }
+                /* No whitespace is allowed between the name and the colon */
+                if (data[pos] != ':')
+                {
+                    return Status::BadRequest;
+                }
+                field.nameEnd = static_cast<uint32_t>(pos++);
+                state = ValueStart;
+                continue;
+
+            case ValueStart:
+                if (c == ' ' || c == '\t')
+                {
+                    ++pos;
+                    continue;
+                }
+                field.valueStart = static_cast<uint32_t>(pos);
+                field.valueEnd = field.valueStart;
+                state = Value;
+                continue;
+
+            case Value:
+                while (pos < end && is(data[pos], VALUE))
+                {
+                    if (data[pos] != ' ' && data[pos] != '\t')
+                    {
+                        field.valueEnd = static_cast<uint32_t>(pos + 1);
+                    }
+                    ++pos;
+                }
+                if (pos == end)
+                {
+                    continue;
+                }
+                if (data[pos] == '\n')
+                {
+                    ++pos;
+                    spans.push_back(field);
+                    state = LineStart;
+                    continue;
+                }
+                if (data[pos] != '\r')
+                {
+                    return Status::BadRequest;
+                }
+                ++pos;
+                state = ValueEnd;
+                continue;
+
+            case Done:
+                return Status::Complete;
+        }
+    }
+
+    if (state == Done)
+    {
+        return Status::Complete;
+    }
+    if (pos >= limits.maxHeaderSize)
+    {
+        return state == Target ? Status::UriTooLong : Status::HeadersTooLarge;
+    }
+    return Status::Incomplete;
+}
+
+void
+HeadParser::reset()
+{
+    state = State::Method;
+    pos = 0;
+    methodStart = 0;
+    spans.clear();
+    result.fields.clear();
+}
+
+HeadParser::Status
+HeadParser::checkVersion(std::string_view input) const
+{
+    std::string_view version = input.substr(versionStart, versionEnd - versionStart);
+    if (version == "HTTP/1.1" || version == "HTTP/1.0")
+    {
+        return Status::Complete;
+    }
+    /* Well-formed but not one we speak */
+    if (version.size() == 8 && version.substr(0, 5) == "HTTP/" && isDigit(version[5]) && version[6] == '.' && isDigit(version[7]))
+    {
+        return Status::VersionNotSupported;
+    }
+    return Status::BadRequest;
+}
+
+void
+HeadParser::finish(std::string_view input)
+{
+    result.method = input.substr(methodStart, targetStart - 1 - methodStart);
+    result.target = input.substr(targetStart, versionStart - 1 - targetStart);
+    result.version = input.substr(versionStart, versionEnd - versionStart);
+    result.fields.clear();
+    for (const FieldSpan& span : spans)
+    {
+        result.fields.push_back(RequestHead::Field{input.substr(span.nameStart, span.nameEnd - span.nameStart),
+                                                   input.substr(span.valueStart, span.valueEnd - span.valueStart)});
+    }
+}
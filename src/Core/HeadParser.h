@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/* Bounds the head is checked against while it is being scanned */
+struct HeadLimits
+{
+    size_t maxHeaderSize;   /* Request line and header fields, blank line included */
+    size_t maxUriLength;
+    size_t maxHeaderCount;
+};
+
+/* Request line and header fields of one request, as views into the parsed input */
+struct RequestHead
+{
+    struct Field
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    std::string_view method;
+    std::string_view target;
+    std::string_view version;
+    std::vector<Field> fields;
+};
+
+/*
+ * Strict HTTP/1.x request head parser (RFC 9112). It makes one pass over the
+ * bytes, resuming where it stopped when more arrive, and gives up at the first
+ * byte that can't belong to a valid head: a method that isn't a token, control
+ * characters in the target, folded or malformed header lines, an unknown
+ * version. Size limits are checked as bytes are scanned, so an oversized head
+ * is refused without waiting for the rest of it.
+ *
+ * Bare LF line endings are accepted, and empty lines before the request line
+ * are skipped, as the RFC allows.
+ */
+class HeadParser
+{
+public:
+    enum class Status
+    {
+        Complete,
+        Incomplete,
+        BadRequest,
+        UriTooLong,
+        HeadersTooLarge,
+        VersionNotSupported
+    };
+
+    /* `input` starts at the request and only grows between calls until reset() */
+    Status parse(std::string_view input, const HeadLimits& limits);
+
+    /* Once Complete: bytes of the head, and the head itself as views into the last input */
+    size_t length() const { return pos; }
+    const RequestHead& head() const { return result; }
+
+    /* Ready for the next request; keeps the field storage */
+    void reset();
+
+private:
+    enum class State : uint8_t
+    {
+        Method,
+        Target,
+        Version,
+        RequestLineEnd,
+        LineStart,
+        Name,
+        ValueStart,
+        Value,
+        ValueEnd,
+        HeadEnd,
+        Done
+    };
+
+    struct FieldSpan
+    {
+        uint32_t nameStart;
+        uint32_t nameEnd;
+        uint32_t valueStart;
+        uint32_t valueEnd;
+    };
+
+    State state = State::Method;
+    size_t pos = 0;
+    size_t methodStart = 0;
+    size_t targetStart = 0;
+    size_t versionStart = 0;
+    size_t versionEnd = 0;
+    FieldSpan field = {};
+    std::vector<FieldSpan> spans;
+    RequestHead result;
+
+    Status checkVersion(std::string_view input) const;
+    void finish(std::string_view input);
+};
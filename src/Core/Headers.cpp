@@ -0,0 +1,324 @@
+#include "Headers.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    constexpr std::array<std::string_view, HeaderCount> HEADER_NAMES = {
+        "Accept", "Accept-Charset", "Accept-Encoding", "Accept-Language", "Authorization", "Cache-Control",
+        "Connection", "Content-Encoding", "Content-Length", "Content-Type", "Cookie", "Date", "Expect",
+        "Forwarded", "Host", "HTTP2-Settings", "If-Match", "If-Modified-Since", "If-None-Match", "If-Range",
+        "Origin", "Pragma", "Range", "Referer", "Sec-WebSocket-Extensions", "Sec-WebSocket-Key",
+        "Sec-WebSocket-Protocol", "Sec-WebSocket-Version", "TE", "Transfer-Encoding", "Upgrade", "User-Agent",
+        "X-Forwarded-For", "X-Forwarded-Proto", "X-Real-IP", "X-Requested-With"
+    };
+
+    /*
+     * Header names are tokens, so OR-ing 0x20 folds letters to lower case and
+     * leaves digits and '-' alone. The multipliers were searched offline to make
+     * the hash collision-free over HEADER_NAMES.
+     */
+    constexpr size_t hashName(std::string_view name)
+    {
+        auto fold = [](char c) { return static_cast<size_t>(static_cast<unsigned char>(c) | 0x20); };
+        return (name.size() * 14 + fold(name.front()) * 33 + fold(name.back()) * 55 + fold(name[name.size() / 2])) & 127;
+    }
+
+    constexpr std::array<uint8_t, 128> HEADER_TABLE = []
+    {
+        std::array<uint8_t, 128> table{};
+        table.fill(0xff);
+        for (size_t i = 0; i < HEADER_NAMES.size(); ++i)
+        {
+            table[hashName(HEADER_NAMES[i])] = static_cast<uint8_t>(i);
+        }
+        return table;
+    }();
+
+    constexpr bool isPerfect()
+    {
+        for (size_t i = 0; i < HEADER_NAMES.size(); ++i)
+        {
+            if (HEADER_TABLE[hashName(HEADER_NAMES[i])] != i)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(isPerfect(), "header name hash has collisions");
+}
+
+HeaderId
+headerId(std::string_view name)
+{
+    if (name.empty())
+    {
+        return HeaderId::Count;
+    }
+
+    uint8_t index = HEADER_TABLE[hashName(name)];
+    if (index == 0xff || !equalsIgnoreCase(HEADER_NAMES[index], name))
+    {
+        return HeaderId::Count;
+    }
+    return static_cast<HeaderId>(index);
+}
+
+std::string_view
+headerName(HeaderId id)
+{
+    return id < HeaderId::Count ? HEADER_NAMES[static_cast<size_t>(id)] : std::string_view();
+}
+
+bool
+equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+Headers::Headers(std::pmr::memory_resource* resource)
+    : fields(resource)
+{
+    slots.fill(Empty);
+}
+
+std::string_view
+Headers::get(HeaderId id) const
+{
+    uint8_t slot = slots[static_cast<size_t>(id)];
+    return slot != Empty ? std::string_view(fields[slot].value) : std::string_view();
+}
+
+std::string_view
+Headers::get(std::string_view name) const
+{
+    HeaderId id = headerId(name);
+    if (id != HeaderId::Count && (has(id) || fields.size() < Empty))
+    {
+        return get(id);
+    }
+
+    for (const Field& field : fields)
+    {
+        if (equalsIgnoreCase(field.name, name))
+        {
+            return field.value;
+        }
+    }
+    return {};
+}
+
+void
+Headers::add(std::string_view name, std::string_view value)
+{
+    HeaderId id = headerId(name);
+    if (Field* field = find(id, name))
+    {
+        field->value.append(id == HeaderId::Cookie ? "; " : ", ");
+        field->value.append(value);
+        return;
+    }
+
+    if (id != HeaderId::Count && fields.size() < Empty)
+    {
+        slots[static_cast<size_t>(id)] = static_cast<uint8_t>(fields.size());
+    }
+    else
+    {
+        /* Past 255 fields a known header is just stored like any other */
+        id = HeaderId::Count;
+    }
+    fields.push_back(Field{id, std::pmr::string(name, fields.get_allocator()), std::pmr::string(value, fields.get_allocator())});
+}
+
+Headers::Field*
+Headers::find(HeaderId id, std::string_view name)
+{
+    if (id != HeaderId::Count)
+    {
+        uint8_t slot = slots[static_cast<size_t>(id)];
+        return slot != Empty ? &fields[slot] : nullptr;
+    }
+
+    auto it = std::find_if(fields.begin(), fields.end(), [name](const Field& field)
+    {
+        return field.id == HeaderId::Count && equalsIgnoreCase(field.name, name);
+    });
+    return it != fields.end() ? &*it : nullptr;
+}
+
+ResponseHeaders::ResponseHeaders(std::pmr::memory_resource* resource)
+    : count(0), spilled(resource), bytes(resource)
+{
+}
+
+std::string_view
+ResponseHeaders::get(std::string_view name) const
+{
+    size_t index = find(name);
+    return index != NotFound ? (*this)[index].value : std::string_view();
+}
+
+void
+ResponseHeaders::set(std::string_view name, std::string_view value)
+{
+    auto aliases = [this](std::string_view str) { return str.data() >= bytes.data() && str.data() < bytes.data() + bytes.size(); };
+    if (aliases(name) || aliases(value))
+    {
+        /* Copied from our own buffer, which may move while it grows */
+        std::string ownName(name);
+        std::string ownValue(value);
+        set(ownName, ownValue);
+        return;
+    }
+
+    size_t index = find(name);
+    if (index != NotFound)
+    {
+        Span& span = spanAt(index);
+        if (value.size() <= span.valueLength)
+        {
+            /* Fits where the old value was */
+            bytes.replace(span.offset + span.nameLength, value.size(), value);
+            span.valueLength = static_cast<uint32_t>(value.size());
+            return;
+        }
+        span.offset = static_cast<uint32_t>(bytes.size());
+        span.valueLength = static_cast<uint32_t>(value.size());
+        bytes.append(name).append(value);
+        return;
+    }
+
+    Span span{static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(name.size()), static_cast<uint32_t>(value.size())};
+    bytes.append(name).append(value);
+    if (count < InlineCapacity)
+    {
+        spans[count] = span;
+    }
+    else
+    {
+        spilled.push_back(span);
+    }
+    ++count;
+}
+
+void
+ResponseHeaders::erase(std::string_view name)
+{
+    size_t index = find(name);
+    if (index == NotFound)
+    {
+        return;
+    }
+    for (size_t i = index; i + 1 < count; ++i)
+    {
+        spanAt(i) = spanAt(i + 1);
+    }
+    if (count > InlineCapacity)
+    {
+        spilled.pop_back();
+    }
+    --count;
+}
+
+ResponseHeaders::Field
+ResponseHeaders::operator[](size_t index) const
+{
+    const Span& span = spanAt(index);
+    std::string_view field(bytes.data() + span.offset, span.nameLength + span.valueLength);
+    return Field{field.substr(0, span.nameLength), field.substr(span.nameLength)};
+}
+
+size_t
+ResponseHeaders::find(std::string_view name) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Span& span = spanAt(i);
+        if (span.nameLength == name.size() && equalsIgnoreCase(std::string_view(bytes.data() + span.offset, span.nameLength), name))
+        {
+            return i;
+        }
+    }
+    return NotFound;
+}
+
+void
+HeaderBlock::set(std::string_view name, std::string_view value)
+{
+    if (contains(name))
+    {
+        /* Rebuilt without the old field; this only happens while configuring */
+        HeaderBlock rebuilt;
+        for (size_t i = 0; i < size(); ++i)
+        {
+            ResponseHeaders::Field field = (*this)[i];
+            if (!equalsIgnoreCase(field.name, name))
+            {
+                rebuilt.set(field.name, field.value);
+            }
+        }
+        *this = std::move(rebuilt);
+    }
+
+    entries.push_back(Entry{block.size(), name.size(), value.size()});
+    block.append(name).append(": ").append(value).append("\r\n");
+    nameLengths |= uint64_t(1) << (name.size() % 64);
+}
+
+bool
+HeaderBlock::contains(std::string_view name) const
+{
+    if (!(nameLengths & (uint64_t(1) << (name.size() % 64))))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < size(); ++i)
+    {
+        if (equalsIgnoreCase((*this)[i].name, name))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+HeaderBlock::appendTo(std::pmr::string& out, const ResponseHeaders& overrides) const
+{
+    bool overridden = false;
+    for (ResponseHeaders::Field field : overrides)
+    {
+        if (contains(field.name))
+        {
+            overridden = true;
+            break;
+        }
+    }
+    if (!overridden)
+    {
+        out.append(block);
+        return;
+    }
+
+    for (const Entry& entry : entries)
+    {
+        if (!overrides.has(std::string_view(block).substr(entry.offset, entry.nameLength)))
+        {
+            out.append(block, entry.offset, lineLength(entry));
+        }
+    }
+}
+
+ResponseHeaders::Field
+HeaderBlock::operator[](size_t index) const
+{
+    const Entry& entry = entries[index];
+    std::string_view line(block.data() + entry.offset, lineLength(entry));
+    return ResponseHeaders::Field{line.substr(0, entry.nameLength), line.substr(entry.nameLength + 2, entry.valueLength)};
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Request headers the server and common handlers look at, interned while parsing */
+enum class HeaderId : uint8_t
+{
+    Accept,
+    AcceptCharset,
+    AcceptEncoding,
+    AcceptLanguage,
+    Authorization,
+    CacheControl,
+    Connection,
+    ContentEncoding,
+    ContentLength,
+    ContentType,
+    Cookie,
+    Date,
+    Expect,
+    Forwarded,
+    Host,
+    Http2Settings,
+    IfMatch,
+    IfModifiedSince,
+    IfNoneMatch,
+    IfRange,
+    Origin,
+    Pragma,
+    Range,
+    Referer,
+    SecWebSocketExtensions,
+    SecWebSocketKey,
+    SecWebSocketProtocol,
+    SecWebSocketVersion,
+    TE,
+    TransferEncoding,
+    Upgrade,
+    UserAgent,
+    XForwardedFor,
+    XForwardedProto,
+    XRealIp,
+    XRequestedWith,
+    Count
+};
+
+constexpr size_t HeaderCount = static_cast<size_t>(HeaderId::Count);
+
+/* Case-insensitive perfect-hash lookup; HeaderId::Count for other names */
+HeaderId headerId(std::string_view name);
+std::string_view headerName(HeaderId id);
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+/*
+ * Header fields of one request. Known headers are reachable in O(1) through
+ * their id, others are found by a case-insensitive scan. Repeated fields are
+ * combined into one comma-separated value (Cookie uses "; ").
+ */
+class Headers
+{
+public:
+    struct Field
+    {
+        HeaderId id;
+        std::pmr::string name;
+        std::pmr::string value;
+    };
+
+    using const_iterator = std::pmr::vector<Field>::const_iterator;
+
+    explicit Headers(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    std::string_view get(HeaderId id) const;
+    std::string_view get(std::string_view name) const;
+    bool has(HeaderId id) const { return slots[static_cast<size_t>(id)] != Empty; }
+
+    void add(std::string_view name, std::string_view value);
+
+    size_t size() const { return fields.size(); }
+    bool empty() const { return fields.empty(); }
+    const_iterator begin() const { return fields.begin(); }
+    const_iterator end() const { return fields.end(); }
+
+private:
+    static constexpr uint8_t Empty = 0xff;
+
+    std::array<uint8_t, HeaderCount> slots;     /* Index into fields per known header */
+    std::pmr::vector<Field> fields;
+
+    Field* find(HeaderId id, std::string_view name);
+};
+
+/*
+ * Header fields of one response, in the order they were set. The first
+ * InlineCapacity fields are indexed inline and all names and values share one
+ * buffer, so a typical response allocates once for its headers. Content-Length
+ * is not stored: it is written from the body when the response is serialized.
+ */
+class ResponseHeaders
+{
+public:
+    struct Field
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    class const_iterator
+    {
+    public:
+        const_iterator(const ResponseHeaders* headers, size_t index) : headers(headers), index(index) {}
+        Field operator*() const { return (*headers)[index]; }
+        const_iterator& operator++() { ++index; return *this; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+    private:
+        const ResponseHeaders* headers;
+        size_t index;
+    };
+
+    static constexpr size_t InlineCapacity = 8;
+
+    explicit ResponseHeaders(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /* Case-insensitive */
+    std::string_view get(std::string_view name) const;
+    bool has(std::string_view name) const { return find(name) != NotFound; }
+    /* Replaces the value of a field with the same name */
+    void set(std::string_view name, std::string_view value);
+    void erase(std::string_view name);
+
+    Field operator[](size_t index) const;
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+private:
+    static constexpr size_t NotFound = SIZE_MAX;
+
+    /* Name immediately followed by value in `bytes` */
+    struct Span
+    {
+        uint32_t offset;
+        uint32_t nameLength;
+        uint32_t valueLength;
+    };
+
+    size_t count;
+    std::array<Span, InlineCapacity> spans;
+    std::pmr::vector<Span> spilled;     /* Fields past InlineCapacity */
+    std::pmr::string bytes;
+
+    size_t find(std::string_view name) const;
+    Span& spanAt(size_t index) { return index < InlineCapacity ? spans[index] : spilled[index - InlineCapacity]; }
+    const Span& spanAt(size_t index) const { return index < InlineCapacity ? spans[index] : spilled[index - InlineCapacity]; }
+};
+
+/*
+ * Header fields serialized once, such as the App-wide defaults, and copied
+ * into every response as a single block. A response that sets one of these
+ * names itself replaces that field.
+ */
+class HeaderBlock
+{
+public:
+    /* Replaces the value of a field with the same name */
+    void set(std::string_view name, std::string_view value);
+    bool contains(std::string_view name) const;
+
+    /* Appends the serialized fields, minus those `overrides` sets */
+    void appendTo(std::pmr::string& out, const ResponseHeaders& overrides) const;
+
+    ResponseHeaders::Field operator[](size_t index) const;
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+private:
+    struct Entry
+    {
+        size_t offset;
+        size_t nameLength;
+        size_t valueLength;
+    };
+
+    std::string block;          /* "Name: value\r\n" for every field */
+    std::vector<Entry> entries;
+    uint64_t nameLengths = 0;   /* Bit per name length mod 64; rules out most names without comparing */
+
+    size_t lineLength(const Entry& entry) const { return entry.nameLength + entry.valueLength + 4; }
+};
@@ -0,0 +1,543 @@
+#include "Hpack.h"
+
+#include <algorithm>
+
+namespace
+{
+    struct Code
+    {
+        uint32_t bits;
+        uint8_t length;
+    };
+
+    /* Indexed by symbol; 256 is EOS */
+    constexpr Code HUFFMAN_CODES[257] = {
+        {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+        {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+        {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+        {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+        {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+        {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+        {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+        {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+        {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+        {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+        {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+        {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+        {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+        {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+        {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+        {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+        {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+        {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+        {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+        {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+        {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+        {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+        {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+        {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+        {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+        {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+        {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+        {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+        {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+        {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+        {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+        {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+        {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+        {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+        {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+        {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+        {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+        {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+        {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+        {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+        {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+        {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+        {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30}
+    };
+
+    /*
+     * The code is canonical (codes of one length are consecutive and ordered
+     * by symbol), so decoding only needs the first code and symbol offset of
+     * each length.
+     */
+    struct DecodeTable
+    {
+        static constexpr int MinLength = 5;
+        static constexpr int MaxLength = 30;
+
+        uint32_t firstCode[MaxLength + 1]{};
+        uint16_t count[MaxLength + 1]{};
+        uint16_t offset[MaxLength + 1]{};
+        uint16_t symbols[257]{};
+
+        DecodeTable()
+        {
+            for (const Code& code : HUFFMAN_CODES)
+            {
+                ++count[code.length];
+            }
+
+            uint32_t next = 0;
+            uint16_t position = 0;
+            for (int length = 1; length <= MaxLength; ++length)
+            {
+                firstCode[length] = next;
+                offset[length] = position;
+                position += count[length];
+                next = (next + count[length]) << 1;
+            }
+
+            uint16_t filled[MaxLength + 1]{};
+            for (uint16_t symbol = 0; symbol < 257; ++symbol)
+            {
+                uint8_t length = HUFFMAN_CODES[symbol].length;
+                symbols[offset[length] + filled[length]++] = symbol;
+            }
+        }
+    };
+
+    const DecodeTable& decodeTable()
+    {
+        static const DecodeTable table;
+        return table;
+    }
+
+    struct StaticEntry
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    constexpr StaticEntry STATIC_TABLE[] = {
+        {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+        {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+        {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+        {":status", "404"}, {":status", "500"}, {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+        {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+        {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+        {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+        {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""},
+        {"from", ""}, {"host", ""}, {"if-match", ""}, {"if-modified-since", ""},
+        {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""}, {"last-modified", ""},
+        {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+        {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""},
+        {"retry-after", ""}, {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""},
+        {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+        {"www-authenticate", ""}
+    };
+
+    constexpr size_t STATIC_TABLE_SIZE = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+    /* RFC 7541 5.1 prefixed integer; false if truncated or too large */
+    bool readInteger(std::string_view block, size_t& pos, int prefixBits, uint64_t& value)
+    {
+        uint8_t mask = static_cast<uint8_t>((1u << prefixBits) - 1);
+        value = static_cast<uint8_t>(block[pos++]) & mask;
+        if (value < mask)
+        {
+            return true;
+        }
+
+        for (int shift = 0; pos < block.size() && shift <= 28; shift += 7)
+        {
+            uint8_t byte = static_cast<uint8_t>(block[pos++]);
+            value += static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void writeInteger(uint64_t value, int prefixBits, uint8_t flags, std::string& out)
+    {
+        uint8_t mask = static_cast<uint8_t>((1u << prefixBits) - 1);
+        if (value < mask)
+        {
+            out.push_back(static_cast<char>(flags | value));
+            return;
+        }
+
+        out.push_back(static_cast<char>(flags | mask));
+        value -= mask;
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    size_t entrySize(std::string_view name, std::string_view value)
+    {
+        return name.size() + value.size() + 32;
+    }
+}
+
+#pragma region Huffman
+
+bool
+Huffman::decode(std::string_view in, std::string& out)
+{
+    const DecodeTable& table = decodeTable();
+    uint32_t code = 0;
+    int length = 0;
+
+    for (char c : in)
+    {
+        uint8_t byte = static_cast<uint8_t>(c);
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            code = (code << 1) | ((byte >> bit) & 1);
+            ++length;
+            if (length < DecodeTable::MinLength)
+            {
+                continue;
+            }
+
+            uint32_t index = code - table.firstCode[length];
+            if (index < table.count[length])
+            {
+                uint16_t symbol = table.symbols[table.offset[length] + index];
+                if (symbol == 256)
+                {
+                    return false;
+                }
+                out.push_back(static_cast<char>(symbol));
+                code = 0;
+                length = 0;
+            }
+            else if (length == DecodeTable::MaxLength)
+            {
+                return false;
+            }
+        }
+    }
+
+    /* Padding is the most significant bits of EOS: fewer than 8 bits, all ones */
+    return length < 8 && code == (1u << length) - 1;
+}
+
+void
+Huffman::encode(std::string_view in, std::string& out)
+{
+    uint64_t bits = 0;
+    int pending = 0;
+    for (char c : in)
+    {
+        const Code& code = HUFFMAN_CODES[static_cast<uint8_t>(c)];
+        bits = (bits << code.length) | code.bits;
+        pending += code.length;
+        while (pending >= 8)
+        {
+            pending -= 8;
+            out.push_back(static_cast<char>(bits >> pending));
+        }
+    }
+
+    if (pending > 0)
+    {
+        out.push_back(static_cast<char>((bits << (8 - pending)) | (0xff >> pending)));
+    }
+}
+
+size_t
+Huffman::encodedLength(std::string_view in)
+{
+    size_t bits = 0;
+    for (char c : in)
+    {
+        bits += HUFFMAN_CODES[static_cast<uint8_t>(c)].length;
+    }
+    return (bits + 7) / 8;
+}
+
+#pragma endregion
+
+#pragma region HpackTable
+
+void
+HpackTable::add(std::string_view name, std::string_view value)
+{
+    size_t needed = entrySize(name, value);
+    if (needed > maxSize)
+    {
+        /* An entry larger than the table just empties it */
+        entries.clear();
+        size = 0;
+        return;
+    }
+
+    evict(needed);
+    entries.push_front(Entry{std::string(name), std::string(value)});
+    size += needed;
+}
+
+void
+HpackTable::setMaxSize(size_t newSize)
+{
+    maxSize = newSize;
+    evict(0);
+}
+
+void
+HpackTable::evict(size_t needed)
+{
+    while (!entries.empty() && size + needed > maxSize)
+    {
+        size -= entrySize(entries.back().name, entries.back().value);
+        entries.pop_back();
+    }
+}
+
+bool
+HpackTable::get(size_t index, std::string_view& name, std::string_view& value) const
+{
+    if (index == 0)
+    {
+        return false;
+    }
+    if (index <= STATIC_TABLE_SIZE)
+    {
+        name = STATIC_TABLE[index - 1].name;
+        value = STATIC_TABLE[index - 1].value;
+        return true;
+    }
+
+    index -= STATIC_TABLE_SIZE + 1;
+    if (index >= entries.size())
+    {
+        return false;
+    }
+    name = entries[index].name;
+    value = entries[index].value;
+    return true;
+}
+
+size_t
+HpackTable::find(std::string_view name, std::string_view value, bool& valueMatches) const
+{
+    size_t nameIndex = 0;
+    valueMatches = false;
+
+    for (size_t i = 0; i < STATIC_TABLE_SIZE; ++i)
+    {
+        if (STATIC_TABLE[i].name != name)
+        {
+            continue;
+        }
+        if (STATIC_TABLE[i].value == value)
+        {
+            valueMatches = true;
+            return i + 1;
+        }
+        if (nameIndex == 0)
+        {
+            nameIndex = i + 1;
+        }
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].name != name)
+        {
+            continue;
+        }
+        if (entries[i].value == value)
+        {
+            valueMatches = true;
+            return STATIC_TABLE_SIZE + 1 + i;
+        }
+        if (nameIndex == 0)
+        {
+            nameIndex = STATIC_TABLE_SIZE + 1 + i;
+        }
+    }
+    return nameIndex;
+}
+
+#pragma endregion
+
+#pragma region HpackDecoder
+
+bool
+HpackDecoder::decode(std::string_view block, const Emit& emit)
+{
+    size_t pos = 0;
+    bool emitted = false;
+    while (pos < block.size())
+    {
+        uint8_t first = static_cast<uint8_t>(block[pos]);
+        uint64_t index = 0;
+
+        if (first & 0x80)
+        {
+            /* Indexed field */
+            std::string_view indexedName;
+            std::string_view indexedValue;
+            if (!readInteger(block, pos, 7, index) || !table.get(index, indexedName, indexedValue))
+            {
+                return false;
+            }
+            emit(indexedName, indexedValue);
+            emitted = true;
+            continue;
+        }
+
+        if ((first & 0xe0) == 0x20)
+        {
+            /* Dynamic table size update: only before the first field, and bounded by what we advertised */
+            if (emitted || !readInteger(block, pos, 5, index) || index > maxTableSize)
+            {
+                return false;
+            }
+            table.setMaxSize(index);
+            continue;
+        }
+
+        /* Literal: with incremental indexing (01), without (0000) or never indexed (0001) */
+        bool indexing = (first & 0xc0) == 0x40;
+        if (!readInteger(block, pos, indexing ? 6 : 4, index))
+        {
+            return false;
+        }
+
+        if (index == 0)
+        {
+            name.clear();
+            if (!readString(block, pos, name))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            std::string_view indexedName;
+            std::string_view indexedValue;
+            if (!table.get(index, indexedName, indexedValue))
+            {
+                return false;
+            }
+            /* Copied: adding this field may evict the entry it names */
+            name = indexedName;
+        }
+
+        value.clear();
+        if (!readString(block, pos, value))
+        {
+            return false;
+        }
+
+        if (indexing)
+        {
+            table.add(name, value);
+        }
+        emit(name, value);
+        emitted = true;
+    }
+    return true;
+}
+
+bool
+HpackDecoder::readString(std::string_view block, size_t& pos, std::string& out)
+{
+    if (pos >= block.size())
+    {
+        return false;
+    }
+
+    bool huffman = static_cast<uint8_t>(block[pos]) & 0x80;
+    uint64_t length = 0;
+    if (!readInteger(block, pos, 7, length) || length > block.size() - pos)
+    {
+        return false;
+    }
+
+    std::string_view str = block.substr(pos, length);
+    pos += length;
+    if (huffman)
+    {
+        return Huffman::decode(str, out);
+    }
+    out.assign(str);
+    return true;
+}
+
+#pragma endregion
+
+#pragma region HpackEncoder
+
+void
+HpackEncoder::setMaxTableSize(size_t size)
+{
+    /* Never grow past the 4096 bytes assumed by default; smaller is honoured */
+    size = std::min<size_t>(size, 4096);
+    if (size != table.getMaxSize())
+    {
+        table.setMaxSize(size);
+        sizeUpdatePending = true;
+    }
+}
+
+void
+HpackEncoder::beginBlock(std::string& out)
+{
+    if (sizeUpdatePending)
+    {
+        writeInteger(table.getMaxSize(), 5, 0x20, out);
+        sizeUpdatePending = false;
+    }
+}
+
+void
+HpackEncoder::encode(std::string_view name, std::string_view value, std::string& out, bool index)
+{
+    bool valueMatches = false;
+    size_t found = table.find(name, value, valueMatches);
+    if (valueMatches)
+    {
+        writeInteger(found, 7, 0x80, out);
+        return;
+    }
+
+    if (index)
+    {
+        writeInteger(found, 6, 0x40, out);
+    }
+    else
+    {
+        writeInteger(found, 4, 0x00, out);
+    }
+    if (found == 0)
+    {
+        writeString(name, out);
+    }
+    writeString(value, out);
+
+    if (index)
+    {
+        table.add(name, value);
+    }
+}
+
+void
+HpackEncoder::writeString(std::string_view str, std::string& out)
+{
+    size_t huffmanLength = Huffman::encodedLength(str);
+    if (huffmanLength < str.size())
+    {
+        writeInteger(huffmanLength, 7, 0x80, out);
+        Huffman::encode(str, out);
+    }
+    else
+    {
+        writeInteger(str.size(), 7, 0x00, out);
+        out.append(str);
+    }
+}
+
+#pragma endregion
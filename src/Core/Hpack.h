@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/* Static Huffman code of RFC 7541 Appendix B */
+class Huffman
+{
+public:
+    /* False if the input is not a valid encoding (bad padding or EOS) */
+    static bool decode(std::string_view in, std::string& out);
+    static void encode(std::string_view in, std::string& out);
+    static size_t encodedLength(std::string_view in);
+};
+
+/* HPACK dynamic table: newest entry first, evicted from the back */
+class HpackTable
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        std::string value;
+    };
+
+    explicit HpackTable(size_t maxSize = 4096) : maxSize(maxSize) {}
+
+    void add(std::string_view name, std::string_view value);
+    void setMaxSize(size_t size);
+    size_t getMaxSize() const { return maxSize; }
+
+    /* Static entries are 1..61, dynamic ones follow; false when out of range */
+    bool get(size_t index, std::string_view& name, std::string_view& value) const;
+
+    /* Best index for a field: 0 if none, `valueMatches` tells if the value matched too */
+    size_t find(std::string_view name, std::string_view value, bool& valueMatches) const;
+
+private:
+    std::deque<Entry> entries;
+    size_t size = 0;
+    size_t maxSize;
+
+    void evict(size_t needed);
+};
+
+class HpackDecoder
+{
+public:
+    using Emit = std::function<void(std::string_view name, std::string_view value)>;
+
+    /* `maxTableSize` is our SETTINGS_HEADER_TABLE_SIZE */
+    explicit HpackDecoder(size_t maxTableSize = 4096) : table(maxTableSize), maxTableSize(maxTableSize) {}
+
+    /* Decodes one complete header block; false on a compression error */
+    bool decode(std::string_view block, const Emit& emit);
+
+private:
+    HpackTable table;
+    size_t maxTableSize;
+    std::string name;
+    std::string value;
+
+    bool readString(std::string_view block, size_t& pos, std::string& out);
+};
+
+class HpackEncoder
+{
+public:
+    /* The peer's SETTINGS_HEADER_TABLE_SIZE; announced at the start of the next block */
+    void setMaxTableSize(size_t size);
+
+    /* Call once before the fields of each header block */
+    void beginBlock(std::string& out);
+
+    /* `index` = false keeps values that change on every response out of the table */
+    void encode(std::string_view name, std::string_view value, std::string& out, bool index = true);
+
+private:
+    HpackTable table;
+    bool sizeUpdatePending = false;
+
+    static void writeString(std::string_view str, std::string& out);
+};
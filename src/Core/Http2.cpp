@@ -0,0 +1,1028 @@
+#include "Http2.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <vector>
+#include "Connection.h"
+#include "Exchange.h"
+
+namespace
+{
+    enum FrameType : uint8_t
+    {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9
+    };
+
+    enum Flag : uint8_t
+    {
+        END_STREAM = 0x1,
+        ACK = 0x1,
+        END_HEADERS = 0x4,
+        PADDED = 0x8,
+        PRIORITY_FLAG = 0x20
+    };
+
+    enum ErrorCode : uint32_t
+    {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        FLOW_CONTROL_ERROR = 0x3,
+        STREAM_CLOSED = 0x5,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        COMPRESSION_ERROR = 0x9,
+        ENHANCE_YOUR_CALM = 0xb
+    };
+
+    enum SettingId : uint16_t
+    {
+        HEADER_TABLE_SIZE = 0x1,
+        ENABLE_PUSH = 0x2,
+        MAX_CONCURRENT_STREAMS = 0x3,
+        INITIAL_WINDOW_SIZE = 0x4,
+        MAX_FRAME_SIZE = 0x5
+    };
+
+    constexpr size_t FRAME_HEADER_SIZE = 9;
+    constexpr uint32_t DEFAULT_WINDOW = 65535;
+    constexpr uint32_t MAX_WINDOW = 0x7fffffff;
+    constexpr uint32_t LOCAL_MAX_FRAME_SIZE = 16384;
+    constexpr uint32_t LOCAL_STREAM_WINDOW = 1 << 20;
+    constexpr uint32_t LOCAL_CONNECTION_WINDOW = 1 << 24;
+
+    uint32_t readUint32(std::string_view data)
+    {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(data[0])) << 24)
+            | (static_cast<uint32_t>(static_cast<uint8_t>(data[1])) << 16)
+            | (static_cast<uint32_t>(static_cast<uint8_t>(data[2])) << 8)
+            | static_cast<uint32_t>(static_cast<uint8_t>(data[3]));
+    }
+
+    void writeUint32(std::string& out, uint32_t value)
+    {
+        out.push_back(static_cast<char>(value >> 24));
+        out.push_back(static_cast<char>(value >> 16));
+        out.push_back(static_cast<char>(value >> 8));
+        out.push_back(static_cast<char>(value));
+    }
+
+    void writeSetting(std::string& out, uint16_t id, uint32_t value)
+    {
+        out.push_back(static_cast<char>(id >> 8));
+        out.push_back(static_cast<char>(id));
+        writeUint32(out, value);
+    }
+
+    /* HTTP2-Settings is base64url without padding */
+    bool decodeBase64Url(std::string_view in, std::string& out)
+    {
+        uint32_t bits = 0;
+        int count = 0;
+        for (char c : in)
+        {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '-' || c == '+') value = 62;
+            else if (c == '_' || c == '/') value = 63;
+            else if (c == '=') break;
+            else return false;
+
+            bits = (bits << 6) | static_cast<uint32_t>(value);
+            count += 6;
+            if (count >= 8)
+            {
+                count -= 8;
+                out.push_back(static_cast<char>(bits >> count));
+            }
+        }
+        return true;
+    }
+
+    bool isTokenChar(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || std::string_view("!#$%&'*+-.^_`|~").find(c) != std::string_view::npos;
+    }
+
+    /* Field names are tokens and, in HTTP/2, lowercase (RFC 9113 section 8.2.1) */
+    bool isFieldName(std::string_view name)
+    {
+        return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) { return isTokenChar(c) && !(c >= 'A' && c <= 'Z'); });
+    }
+
+    /* CR, LF and NUL would split the value into fields of its own once it is in a Request */
+    bool isFieldValue(std::string_view value)
+    {
+        return value.find_first_of(std::string_view("\r\n\0", 3)) == std::string_view::npos;
+    }
+
+    /* Origin form only: a non-empty path with no spaces or control bytes */
+    bool isPath(std::string_view path)
+    {
+        return !path.empty() && path[0] == '/'
+            && std::none_of(path.begin(), path.end(), [](char c) { return static_cast<unsigned char>(c) <= 0x20 || c == 0x7f; });
+    }
+
+    /* Hop-by-hop fields have no meaning in HTTP/2 and make a message malformed (RFC 9113 section 8.2.2) */
+    bool isConnectionSpecific(std::string_view name)
+    {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection"
+            || name == "transfer-encoding" || name == "upgrade";
+    }
+}
+
+Http2Session::Http2Session(Connection& connection, size_t maxRequestSize, const HeaderBlock& defaults, RequestCallback onRequest)
+    : connection(connection), maxRequestSize(maxRequestSize), defaults(defaults), onRequest(std::move(onRequest)),
+      blocked(0), running(0), prefaceSeen(false), failed(false), goingAway(false), lastStreamId(0),
+      headerStream(0), headerEndStream(false), connectionSendWindow(DEFAULT_WINDOW),
+      peerInitialWindow(DEFAULT_WINDOW), peerMaxFrameSize(LOCAL_MAX_FRAME_SIZE), connectionUnacked(0)
+{
+}
+
+Http2Session::~Http2Session()
+{
+    for (auto& entry : streams)
+    {
+        if (entry.second.exchange && !entry.second.running)
+        {
+            entry.second.exchange->release();
+        }
+    }
+}
+
+void
+Http2Session::start()
+{
+    std::string settings;
+    writeSetting(settings, MAX_CONCURRENT_STREAMS, MaxConcurrentStreams);
+    writeSetting(settings, INITIAL_WINDOW_SIZE, LOCAL_STREAM_WINDOW);
+    writeFrameHeader(settings.size(), SETTINGS, 0, 0);
+    frames.append(settings);
+
+    writeFrameHeader(4, WINDOW_UPDATE, 0, 0);
+    writeUint32(frames, LOCAL_CONNECTION_WINDOW - DEFAULT_WINDOW);
+    flushFrames();
+}
+
+bool
+Http2Session::upgrade(std::string_view settings, Exchange* exchange)
+{
+    std::string payload;
+    if (!decodeBase64Url(settings, payload) || payload.size() % 6 != 0)
+    {
+        return false;
+    }
+    for (size_t pos = 0; pos < payload.size(); pos += 6)
+    {
+        uint16_t id = static_cast<uint16_t>((static_cast<uint8_t>(payload[pos]) << 8) | static_cast<uint8_t>(payload[pos + 1]));
+        if (!applySetting(id, readUint32(std::string_view(payload).substr(pos + 2))))
+        {
+            return false;
+        }
+    }
+
+    /* The upgraded request is stream 1, already half-closed by the client */
+    Stream& stream = streams[1];
+    stream.exchange = exchange;
+    stream.sendWindow = peerInitialWindow;
+    stream.remoteClosed = true;
+    lastStreamId = 1;
+    exchange->streamId = 1;
+    dispatch(stream);
+    return true;
+}
+
+void
+Http2Session::receive()
+{
+    while (!failed)
+    {
+        std::string_view input = connection.unparsed();
+        if (!prefaceSeen)
+        {
+            if (input.size() < Preface.size())
+            {
+                break;
+            }
+            if (input.substr(0, Preface.size()) != Preface)
+            {
+                goAway(PROTOCOL_ERROR);
+                break;
+            }
+            connection.consume(Preface.size());
+            prefaceSeen = true;
+            continue;
+        }
+
+        if (input.size() < FRAME_HEADER_SIZE)
+        {
+            break;
+        }
+        uint32_t length = (static_cast<uint32_t>(static_cast<uint8_t>(input[0])) << 16)
+            | (static_cast<uint32_t>(static_cast<uint8_t>(input[1])) << 8)
+            | static_cast<uint32_t>(static_cast<uint8_t>(input[2]));
+        if (length > LOCAL_MAX_FRAME_SIZE)
+        {
+            goAway(FRAME_SIZE_ERROR);
+            break;
+        }
+        if (input.size() < FRAME_HEADER_SIZE + length)
+        {
+            break;
+        }
+
+        uint8_t type = static_cast<uint8_t>(input[3]);
+        uint8_t flags = static_cast<uint8_t>(input[4]);
+        uint32_t streamId = readUint32(input.substr(5)) & MAX_WINDOW;
+        bool handled = handleFrame(type, flags, streamId, input.substr(FRAME_HEADER_SIZE, length));
+        connection.consume(FRAME_HEADER_SIZE + length);
+        if (!handled)
+        {
+            break;
+        }
+    }
+    flushFrames();
+}
+
+bool
+Http2Session::handleFrame(uint8_t type, uint8_t flags, uint32_t streamId, std::string_view payload)
+{
+    if (headerStream != 0 && (type != CONTINUATION || streamId != headerStream))
+    {
+        /* A header block must not be interleaved with anything */
+        return goAway(PROTOCOL_ERROR);
+    }
+
+    switch (type)
+    {
+        case DATA:
+            return onData(flags, streamId, payload);
+
+        case HEADERS:
+            return onHeaders(flags, streamId, payload);
+
+        case CONTINUATION:
+            if (headerStream == 0)
+            {
+                return goAway(PROTOCOL_ERROR);
+            }
+            headerBlock.append(payload);
+            if (headerBlock.size() > maxRequestSize)
+            {
+                return goAway(ENHANCE_YOUR_CALM);
+            }
+            if (flags & END_HEADERS)
+            {
+                headerStream = 0;
+                return onHeaderBlock(streamId, headerEndStream);
+            }
+            return true;
+
+        case PRIORITY:
+            return true;
+
+        case RST_STREAM:
+            if (streamId == 0 || payload.size() != 4)
+            {
+                return goAway(payload.size() != 4 ? FRAME_SIZE_ERROR : PROTOCOL_ERROR);
+            }
+            onReset(streamId);
+            return true;
+
+        case SETTINGS:
+            return onSettings(flags, streamId, payload);
+
+        case PUSH_PROMISE:
+            /* Clients never push */
+            return goAway(PROTOCOL_ERROR);
+
+        case PING:
+            if (streamId != 0 || payload.size() != 8)
+            {
+                return goAway(payload.size() != 8 ? FRAME_SIZE_ERROR : PROTOCOL_ERROR);
+            }
+            if (!(flags & ACK))
+            {
+                writeFrameHeader(8, PING, ACK, 0);
+                frames.append(payload);
+            }
+            return true;
+
+        case GOAWAY:
+            /* Finish what is in flight, take no new streams, then close */
+            goingAway = true;
+            connection.closeAfterWrite = true;
+            return true;
+
+        case WINDOW_UPDATE:
+            return onWindowUpdate(streamId, payload);
+
+        default:
+            /* Unknown frame types are ignored */
+            return true;
+    }
+}
+
+bool
+Http2Session::onData(uint8_t flags, uint32_t streamId, std::string_view payload)
+{
+    if (streamId == 0)
+    {
+        return goAway(PROTOCOL_ERROR);
+    }
+
+    /* Flow control counts the whole payload, padding included */
+    connectionUnacked += static_cast<uint32_t>(payload.size());
+    if (connectionUnacked >= LOCAL_CONNECTION_WINDOW / 2)
+    {
+        writeFrameHeader(4, WINDOW_UPDATE, 0, 0);
+        writeUint32(frames, connectionUnacked);
+        connectionUnacked = 0;
+    }
+
+    if (flags & PADDED)
+    {
+        size_t padding = payload.empty() ? 0 : static_cast<uint8_t>(payload[0]);
+        if (payload.empty() || padding >= payload.size())
+        {
+            return goAway(PROTOCOL_ERROR);
+        }
+        payload = payload.substr(1, payload.size() - 1 - padding);
+    }
+
+    auto it = streams.find(streamId);
+    if (it == streams.end() || it->second.remoteClosed)
+    {
+        if (streamId > lastStreamId)
+        {
+            return goAway(PROTOCOL_ERROR);
+        }
+        /* Data for a stream we already answered or refused */
+        if (it != streams.end())
+        {
+            resetStream(streamId, STREAM_CLOSED);
+        }
+        return true;
+    }
+
+    Stream& stream = it->second;
+    std::pmr::string& body = stream.exchange->req.body;
+    if (body.size() + payload.size() > maxRequestSize)
+    {
+        refuse(streamId, stream, 413);
+        return true;
+    }
+    body.append(payload);
+    if (stream.expectedLength >= 0 && body.size() > static_cast<uint64_t>(stream.expectedLength))
+    {
+        resetStream(streamId, PROTOCOL_ERROR);
+        closeStream(streamId);
+        return true;
+    }
+
+    if (flags & END_STREAM)
+    {
+        stream.remoteClosed = true;
+        if (bodyComplete(streamId, stream))
+        {
+            dispatch(stream);
+        }
+        return true;
+    }
+
+    stream.unacked += static_cast<uint32_t>(payload.size());
+    if (stream.unacked >= LOCAL_STREAM_WINDOW / 2)
+    {
+        writeFrameHeader(4, WINDOW_UPDATE, 0, streamId);
+        writeUint32(frames, stream.unacked);
+        stream.unacked = 0;
+    }
+    return true;
+}
+
+bool
+Http2Session::onHeaders(uint8_t flags, uint32_t streamId, std::string_view payload)
+{
+    if (streamId == 0)
+    {
+        return goAway(PROTOCOL_ERROR);
+    }
+
+    size_t padding = 0;
+    if (flags & PADDED)
+    {
+        if (payload.empty())
+        {
+            return goAway(PROTOCOL_ERROR);
+        }
+        padding = static_cast<uint8_t>(payload[0]);
+        payload.remove_prefix(1);
+    }
+    if (flags & PRIORITY_FLAG)
+    {
+        if (payload.size() < 5)
+        {
+            return goAway(PROTOCOL_ERROR);
+        }
+        payload.remove_prefix(5);
+    }
+    if (padding > payload.size())
+    {
+        return goAway(PROTOCOL_ERROR);
+    }
+    payload.remove_suffix(padding);
+
+    headerBlock.assign(payload);
+    if (!(flags & END_HEADERS))
+    {
+        headerStream = streamId;
+        headerEndStream = flags & END_STREAM;
+        return true;
+    }
+    return onHeaderBlock(streamId, flags & END_STREAM);
+}
+
+bool
+Http2Session::onHeaderBlock(uint32_t streamId, bool endStream)
+{
+    /* Names and values are copied into `fieldBytes`; the head views into it once the block is decoded */
+    struct FieldSpan
+    {
+        size_t start;
+        size_t nameLength;
+        size_t valueLength;
+    };
+
+    std::string method;
+    std::string path;
+    std::string authority;
+    std::string fieldBytes;
+    std::vector<FieldSpan> spans;
+    std::string_view contentLength;
+    size_t contentLengthCount = 0;
+    bool malformed = false;
+    bool regularSeen = false;
+
+    /* Always decoded, even for streams that get refused, to keep the HPACK table in sync */
+    bool decoded = decoder.decode(headerBlock, [&](std::string_view name, std::string_view value)
+    {
+        if (!isFieldValue(value))
+        {
+            malformed = true;
+            return;
+        }
+        if (!name.empty() && name[0] == ':')
+        {
+            /* Pseudo-headers come first, once each */
+            std::string* target = name == ":method" ? &method : name == ":path" ? &path
+                : name == ":authority" ? &authority : nullptr;
+            if (regularSeen || (target && !target->empty()))
+            {
+                malformed = true;
+            }
+            else if (target)
+            {
+                target->assign(value);
+            }
+            else if (name != ":scheme" && name != ":protocol")
+            {
+                malformed = true;
+            }
+            return;
+        }
+
+        regularSeen = true;
+        if (!isFieldName(name) || isConnectionSpecific(name) || (name == "te" && value != "trailers"))
+        {
+            malformed = true;
+            return;
+        }
+        if (name == "content-length")
+        {
+            ++contentLengthCount;
+        }
+        spans.push_back(FieldSpan{fieldBytes.size(), name.size(), value.size()});
+        fieldBytes.append(name).append(value);
+    });
+    headerBlock.clear();
+    if (!decoded)
+    {
+        return goAway(COMPRESSION_ERROR);
+    }
+
+    auto it = streams.find(streamId);
+    if (it != streams.end())
+    {
+        /* Trailers: nothing in them is used, they just end the request */
+        if (!endStream || it->second.remoteClosed)
+        {
+            resetStream(streamId, PROTOCOL_ERROR);
+            return true;
+        }
+        it->second.remoteClosed = true;
+        if (!bodyComplete(streamId, it->second))
+        {
+            return true;
+        }
+        dispatch(it->second);
+        return true;
+    }
+
+    if (streamId % 2 == 0 || streamId <= lastStreamId)
+    {
+        return goAway(PROTOCOL_ERROR);
+    }
+    lastStreamId = streamId;
+
+    if (goingAway || streams.size() >= MaxConcurrentStreams)
+    {
+        resetStream(streamId, REFUSED_STREAM);
+        return true;
+    }
+
+    RequestHead head;
+    head.method = method;
+    head.target = path;
+    head.version = "HTTP/2.0";
+    head.fields.reserve(spans.size() + 1);
+    if (!authority.empty())
+    {
+        head.fields.push_back(RequestHead::Field{"Host", authority});
+    }
+    for (const FieldSpan& span : spans)
+    {
+        std::string_view name = std::string_view(fieldBytes).substr(span.start, span.nameLength);
+        std::string_view value = std::string_view(fieldBytes).substr(span.start + span.nameLength, span.valueLength);
+        head.fields.push_back(RequestHead::Field{name, value});
+        if (name == "content-length")
+        {
+            contentLength = value;
+        }
+    }
+
+    /* Content-Length has to be one plain number, as over HTTP/1 */
+    uint64_t length = 0;
+    bool lengthValid = true;
+    if (contentLengthCount > 0)
+    {
+        auto result = std::from_chars(contentLength.data(), contentLength.data() + contentLength.size(), length);
+        lengthValid = contentLengthCount == 1 && result.ec == std::errc() && result.ptr == contentLength.data() + contentLength.size();
+    }
+
+    bool methodValid = !method.empty() && std::all_of(method.begin(), method.end(), isTokenChar);
+    if (malformed || !methodValid || !isPath(path) || !lengthValid)
+    {
+        resetStream(streamId, PROTOCOL_ERROR);
+        return true;
+    }
+
+    Exchange* exchange = Exchange::create(head);
+    exchange->connection = &connection;
+    exchange->streamId = streamId;
+    ++connection.inFlight;
+
+    Stream& stream = streams[streamId];
+    stream.exchange = exchange;
+    stream.sendWindow = peerInitialWindow;
+    stream.expectedLength = contentLengthCount > 0 ? static_cast<int64_t>(std::min<uint64_t>(length, INT64_MAX)) : -1;
+
+    if (length > maxRequestSize)
+    {
+        refuse(streamId, stream, 413);
+        return true;
+    }
+    exchange->req.body.reserve(static_cast<size_t>(length));
+
+    if (endStream)
+    {
+        stream.remoteClosed = true;
+        if (!bodyComplete(streamId, stream))
+        {
+            return true;
+        }
+        dispatch(stream);
+    }
+    return true;
+}
+
+bool
+Http2Session::bodyComplete(uint32_t streamId, Stream& stream)
+{
+    /* The DATA received has to add up to the declared Content-Length (RFC 9113 section 8.1.1) */
+    if (stream.expectedLength < 0 || stream.exchange->req.body.size() == static_cast<uint64_t>(stream.expectedLength))
+    {
+        return true;
+    }
+    resetStream(streamId, PROTOCOL_ERROR);
+    closeStream(streamId);
+    return false;
+}
+
+bool
+Http2Session::onSettings(uint8_t flags, uint32_t streamId, std::string_view payload)
+{
+    if (streamId != 0)
+    {
+        return goAway(PROTOCOL_ERROR);
+    }
+    if (flags & ACK)
+    {
+        return payload.empty() || goAway(FRAME_SIZE_ERROR);
+    }
+    if (payload.size() % 6 != 0)
+    {
+        return goAway(FRAME_SIZE_ERROR);
+    }
+
+    for (size_t pos = 0; pos < payload.size(); pos += 6)
+    {
+        uint16_t id = static_cast<uint16_t>((static_cast<uint8_t>(payload[pos]) << 8) | static_cast<uint8_t>(payload[pos + 1]));
+        if (!applySetting(id, readUint32(payload.substr(pos + 2))))
+        {
+            return goAway(id == INITIAL_WINDOW_SIZE ? FLOW_CONTROL_ERROR : PROTOCOL_ERROR);
+        }
+    }
+    writeFrameHeader(0, SETTINGS, ACK, 0);
+    pump();
+    return true;
+}
+
+bool
+Http2Session::applySetting(uint16_t id, uint32_t value)
+{
+    switch (id)
+    {
+        case HEADER_TABLE_SIZE:
+            encoder.setMaxTableSize(value);
+            return true;
+
+        case ENABLE_PUSH:
+            return value <= 1;
+
+        case INITIAL_WINDOW_SIZE:
+        {
+            if (value > MAX_WINDOW)
+            {
+                return false;
+            }
+            /* Applies to every open stream retroactively */
+            int64_t delta = static_cast<int64_t>(value) - static_cast<int64_t>(peerInitialWindow);
+            peerInitialWindow = value;
+            for (auto& entry : streams)
+            {
+                Stream& stream = entry.second;
+                stream.sendWindow += delta;
+                if (stream.waiting && stream.sendWindow > 0)
+                {
+                    stream.waiting = false;
+                    --blocked;
+                    sending.push_back(entry.first);
+                }
+            }
+            return true;
+        }
+
+        case MAX_FRAME_SIZE:
+            if (value < 16384 || value > 16777215)
+            {
+                return false;
+            }
+            peerMaxFrameSize = value;
+            return true;
+
+        default:
+            /* Unknown or irrelevant settings are ignored */
+            return true;
+    }
+}
+
+bool
+Http2Session::onWindowUpdate(uint32_t streamId, std::string_view payload)
+{
+    if (payload.size() != 4)
+    {
+        return goAway(FRAME_SIZE_ERROR);
+    }
+
+    uint32_t increment = readUint32(payload) & MAX_WINDOW;
+    if (streamId == 0)
+    {
+        if (increment == 0 || connectionSendWindow + increment > MAX_WINDOW)
+        {
+            return goAway(increment == 0 ? PROTOCOL_ERROR : FLOW_CONTROL_ERROR);
+        }
+        connectionSendWindow += increment;
+        pump();
+        return true;
+    }
+
+    auto it = streams.find(streamId);
+    if (it == streams.end())
+    {
+        return true;
+    }
+    Stream& stream = it->second;
+    if (increment == 0 || stream.sendWindow + increment > MAX_WINDOW)
+    {
+        resetStream(streamId, increment == 0 ? PROTOCOL_ERROR : FLOW_CONTROL_ERROR);
+        onReset(streamId);
+        return true;
+    }
+
+    stream.sendWindow += increment;
+    if (stream.waiting && stream.sendWindow > 0)
+    {
+        stream.waiting = false;
+        --blocked;
+        sending.push_back(streamId);
+        pump();
+    }
+    return true;
+}
+
+void
+Http2Session::onReset(uint32_t streamId)
+{
+    auto it = streams.find(streamId);
+    if (it == streams.end())
+    {
+        return;
+    }
+
+    Stream& stream = it->second;
+    if (stream.running)
+    {
+        /* The handler still holds the exchange; respond() drops it */
+        stream.reset = true;
+        return;
+    }
+    closeStream(streamId);
+}
+
+void
+Http2Session::dispatch(Stream& stream)
+{
+    /* Nothing more will arrive on this stream, so its window is never returned */
+    stream.unacked = 0;
+    stream.running = true;
+    ++running;
+    onRequest(stream.exchange);
+}
+
+void
+Http2Session::refuse(uint32_t streamId, Stream& stream, int status)
+{
+    /* Answer without running the handler and tell the client to stop sending */
+    char code[8];
+    auto result = std::to_chars(code, code + sizeof(code), status);
+    std::string block;
+    encoder.beginBlock(block);
+    encoder.encode(":status", std::string_view(code, result.ptr - code), block);
+    encoder.encode("content-length", "0", block);
+    writeHeaderBlock(streamId, block, true);
+    resetStream(streamId, NO_ERROR);
+
+    stream.remoteClosed = true;
+    closeStream(streamId);
+}
+
+void
+Http2Session::respond(Exchange* exchange)
+{
+    --running;
+    uint32_t streamId = exchange->streamId;
+    auto it = streams.find(streamId);
+    if (failed || it == streams.end() || it->second.reset)
+    {
+        if (it != streams.end())
+        {
+            streams.erase(it);
+        }
+        releaseExchange(exchange);
+        return;
+    }
+
+    Stream& stream = it->second;
+    stream.running = false;
+
+    const Response& res = exchange->res;
+    char code[8];
+    auto result = std::to_chars(code, code + sizeof(code), res.statusCode);
+
+    std::string block;
+    encoder.beginBlock(block);
+    encoder.encode(":status", std::string_view(code, result.ptr - code), block);
+    for (size_t i = 0; i < defaults.size(); ++i)
+    {
+        if (!res.headers.has(defaults[i].name))
+        {
+            encodeHeader(defaults[i], block);
+        }
+    }
+    for (ResponseHeaders::Field header : res.headers)
+    {
+        encodeHeader(header, block);
+    }
+    char length[24];
+    result = std::to_chars(length, length + sizeof(length), res.content().size());
+    /* Values that change on every response would only churn the dynamic table */
+    encoder.encode("content-length", std::string_view(length, result.ptr - length), block, false);
+
+    bool hasBody = !res.content().empty() && exchange->req.method != "HEAD";
+    writeHeaderBlock(streamId, block, !hasBody);
+    if (!hasBody)
+    {
+        closeStream(streamId);
+        flushFrames();
+        return;
+    }
+
+    sending.push_back(streamId);
+    pump();
+    flushFrames();
+}
+
+void
+Http2Session::encodeHeader(ResponseHeaders::Field header, std::string& block)
+{
+    std::string name(header.name);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (isConnectionSpecific(name))
+    {
+        return;
+    }
+    bool index = name != "date" && name != "set-cookie";
+    encoder.encode(name, header.value, block, index);
+}
+
+void
+Http2Session::pump()
+{
+    while (!sending.empty() && connectionSendWindow > 0 && !failed)
+    {
+        uint32_t streamId = sending.front();
+        sending.pop_front();
+        auto it = streams.find(streamId);
+        if (it == streams.end())
+        {
+            continue;
+        }
+
+        Stream& stream = it->second;
+        std::string_view body = stream.exchange->res.content();
+        if (stream.sendWindow <= 0)
+        {
+            stream.waiting = true;
+            ++blocked;
+            continue;
+        }
+
+        size_t length = std::min<size_t>({body.size() - stream.sent, static_cast<size_t>(stream.sendWindow),
+                                          static_cast<size_t>(connectionSendWindow), peerMaxFrameSize});
+        bool last = stream.sent + length == body.size();
+        writeFrameHeader(length, DATA, last ? END_STREAM : 0, streamId);
+        flushFrames();
+
+        /* The payload goes out straight from the response body; the last piece releases the exchange */
+        Exchange* exchange = stream.exchange;
+        connection.queue(body.data() + stream.sent, length, last ? exchange : nullptr);
+        stream.sent += length;
+        stream.sendWindow -= static_cast<int64_t>(length);
+        connectionSendWindow -= static_cast<int64_t>(length);
+
+        if (last)
+        {
+            /* The exchange now belongs to the connection's output queue */
+            stream.exchange = nullptr;
+            streams.erase(it);
+        }
+        else
+        {
+            /* Round-robin so one large response doesn't starve the others */
+            sending.push_back(streamId);
+        }
+    }
+}
+
+void
+Http2Session::closeStream(uint32_t streamId)
+{
+    auto it = streams.find(streamId);
+    if (it == streams.end())
+    {
+        return;
+    }
+
+    Stream& stream = it->second;
+    if (stream.waiting)
+    {
+        --blocked;
+    }
+    sending.erase(std::remove(sending.begin(), sending.end(), streamId), sending.end());
+
+    if (stream.exchange)
+    {
+        if (stream.sent > 0)
+        {
+            /* Earlier DATA still points into the body; release once it has been written */
+            flushFrames();
+            connection.queue(nullptr, 0, stream.exchange);
+        }
+        else
+        {
+            releaseExchange(stream.exchange);
+        }
+    }
+    streams.erase(it);
+}
+
+void
+Http2Session::releaseExchange(Exchange* exchange)
+{
+    exchange->release();
+    --connection.inFlight;
+}
+
+bool
+Http2Session::goAway(uint32_t error)
+{
+    writeFrameHeader(8, GOAWAY, 0, 0);
+    writeUint32(frames, lastStreamId);
+    writeUint32(frames, error);
+    flushFrames();
+
+    failed = true;
+    goingAway = true;
+    connection.closeAfterWrite = true;
+
+    /* Running streams are dropped by respond(); everything else ends here */
+    for (auto it = streams.begin(); it != streams.end();)
+    {
+        uint32_t streamId = it->first;
+        bool busy = it->second.running;
+        ++it;
+        if (!busy)
+        {
+            closeStream(streamId);
+        }
+    }
+    return false;
+}
+
+void
+Http2Session::resetStream(uint32_t streamId, uint32_t error)
+{
+    writeFrameHeader(4, RST_STREAM, 0, streamId);
+    writeUint32(frames, error);
+}
+
+void
+Http2Session::writeFrameHeader(size_t length, uint8_t type, uint8_t flags, uint32_t streamId)
+{
+    frames.push_back(static_cast<char>(length >> 16));
+    frames.push_back(static_cast<char>(length >> 8));
+    frames.push_back(static_cast<char>(length));
+    frames.push_back(static_cast<char>(type));
+    frames.push_back(static_cast<char>(flags));
+    writeUint32(frames, streamId);
+}
+
+void
+Http2Session::writeHeaderBlock(uint32_t streamId, std::string_view block, bool endStream)
+{
+    /* HEADERS then CONTINUATION frames, each within the peer's frame size */
+    uint8_t type = HEADERS;
+    do
+    {
+        size_t length = std::min<size_t>(block.size(), peerMaxFrameSize);
+        uint8_t flags = (length == block.size() ? END_HEADERS : 0) | (type == HEADERS && endStream ? END_STREAM : 0);
+        writeFrameHeader(length, type, flags, streamId);
+        frames.append(block.substr(0, length));
+        block.remove_prefix(length);
+        type = CONTINUATION;
+    }
+    while (!block.empty());
+}
+
+void
+Http2Session::flushFrames()
+{
+    if (!frames.empty())
+    {
+        connection.queue(std::move(frames));
+        frames.clear();
+    }
+}
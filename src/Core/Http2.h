@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "Headers.h"
+#include "Hpack.h"
+
+class Connection;
+struct Exchange;
+
+/*
+ * HTTP/2 (h2c) on one connection, entered with prior knowledge or through an
+ * HTTP/1.1 Upgrade. Lives on the event loop thread like its Connection: frames
+ * are read from the connection's input, each request stream becomes an
+ * Exchange handed to onRequest, and finished exchanges come back through
+ * respond() to be sent as HEADERS and flow-controlled DATA frames.
+ *
+ * Request bodies are collected before the handler runs (bounded by
+ * maxRequestSize), so streamBody routes see a complete body here.
+ */
+class Http2Session
+{
+public:
+    using RequestCallback = std::function<void(Exchange* exchange)>;
+
+    static constexpr std::string_view Preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    static constexpr uint32_t MaxConcurrentStreams = 100;
+
+    /* `defaults` are sent with every response and must outlive the session */
+    Http2Session(Connection& connection, size_t maxRequestSize, const HeaderBlock& defaults, RequestCallback onRequest);
+    ~Http2Session();
+
+    Http2Session(const Http2Session&) = delete;
+    Http2Session& operator=(const Http2Session&) = delete;
+
+    /* Queues our SETTINGS; must be the first thing sent */
+    void start();
+
+    /* h2c upgrade: applies the HTTP2-Settings header and adopts the request as stream 1 */
+    bool upgrade(std::string_view settings, Exchange* exchange);
+
+    /* Handles every complete frame in the connection's input */
+    void receive();
+
+    /* Sends the response of an exchange handed out by onRequest */
+    void respond(Exchange* exchange);
+
+    /* No handler running and no response waiting for flow-control window */
+    bool idle() const { return running == 0 && sending.empty() && blocked == 0; }
+
+private:
+    struct Stream
+    {
+        Exchange* exchange = nullptr;
+        int64_t sendWindow = 0;
+        size_t sent = 0;                /* Response body bytes already framed */
+        uint32_t unacked = 0;           /* Received bytes not yet returned with WINDOW_UPDATE */
+        bool remoteClosed = false;
+        bool running = false;           /* Owned by a handler until respond() */
+        bool reset = false;
+        bool waiting = false;           /* Response blocked on the stream window */
+        int64_t expectedLength = -1;    /* Declared content-length, -1 without one */
+    };
+
+    Connection& connection;
+    size_t maxRequestSize;
+    const HeaderBlock& defaults;
+    RequestCallback onRequest;
+
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+    std::unordered_map<uint32_t, Stream> streams;
+    std::deque<uint32_t> sending;       /* Streams with response data and window to send it */
+    size_t blocked;
+    size_t running;
+
+    bool prefaceSeen;
+    bool failed;
+    bool goingAway;
+    uint32_t lastStreamId;
+
+    /* HEADERS waiting for CONTINUATION */
+    std::string headerBlock;
+    uint32_t headerStream;
+    bool headerEndStream;
+
+    int64_t connectionSendWindow;
+    uint32_t peerInitialWindow;
+    uint32_t peerMaxFrameSize;
+    uint32_t connectionUnacked;
+
+    std::string frames;                 /* Control frames and frame headers not yet queued */
+
+    bool handleFrame(uint8_t type, uint8_t flags, uint32_t streamId, std::string_view payload);
+    bool onData(uint8_t flags, uint32_t streamId, std::string_view payload);
+    bool onHeaders(uint8_t flags, uint32_t streamId, std::string_view payload);
+    bool onHeaderBlock(uint32_t streamId, bool endStream);
+    bool bodyComplete(uint32_t streamId, Stream& stream);
+    bool onSettings(uint8_t flags, uint32_t streamId, std::string_view payload);
+    bool applySetting(uint16_t id, uint32_t value);
+    bool onWindowUpdate(uint32_t streamId, std::string_view payload);
+    void onReset(uint32_t streamId);
+
+    void dispatch(Stream& stream);
+    void refuse(uint32_t streamId, Stream& stream, int status);
+    void encodeHeader(ResponseHeaders::Field header, std::string& block);
+    void pump();
+    void closeStream(uint32_t streamId);
+    void releaseExchange(Exchange* exchange);
+
+    bool goAway(uint32_t error);
+    void resetStream(uint32_t streamId, uint32_t error);
+    void writeFrameHeader(size_t length, uint8_t type, uint8_t flags, uint32_t streamId);
+    void writeHeaderBlock(uint32_t streamId, std::string_view block, bool endStream);
+    void flushFrames();
+};
@@ -0,0 +1,20 @@
+#include "HttpDate.h"
+
+#include <ctime>
+
+std::string_view
+httpDate()
+{
+    thread_local time_t formattedAt = 0;
+    thread_local char date[HttpDateLength + 1];
+
+    time_t now = time(nullptr);
+    if (now != formattedAt)
+    {
+        tm utc;
+        gmtime_r(&now, &utc);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+        formattedAt = now;
+    }
+    return std::string_view(date, HttpDateLength);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+constexpr size_t HttpDateLength = 29;
+
+/* Current time as an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT"), formatted at most once a second per thread */
+std::string_view httpDate();
@@ -0,0 +1,649 @@
+#include "Json.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t MAX_DEPTH = 1024;
+    constexpr uint64_t EVEN_BITS = 0x5555555555555555ULL;
+
+    const JsonValue NULL_VALUE;
+
+    /* One bit per byte of a 64-byte block */
+    struct Block
+    {
+        uint64_t quote;
+        uint64_t backslash;
+        uint64_t op;            /* { } [ ] : , */
+        uint64_t whitespace;
+        uint64_t control;       /* Below 0x20, never allowed unescaped in a string */
+    };
+
+#if defined(__SSE2__)
+    uint64_t matches(__m128i chunk, char c)
+    {
+        return static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c))));
+    }
+
+    Block classify(const char* data)
+    {
+        Block block = {};
+        const __m128i belowSpace = _mm_set1_epi8(0x1F);
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i));
+            int shift = 16 * i;
+            block.quote |= matches(chunk, '"') << shift;
+            block.backslash |= matches(chunk, '\\') << shift;
+            block.op |= (matches(chunk, '{') | matches(chunk, '}') | matches(chunk, '[') | matches(chunk, ']') |
+                         matches(chunk, ':') | matches(chunk, ',')) << shift;
+            block.whitespace |= (matches(chunk, ' ') | matches(chunk, '\t') | matches(chunk, '\n') |
+                                 matches(chunk, '\r')) << shift;
+            /* max(c, 0x1F) == 0x1F exactly for the unsigned bytes below 0x20 */
+            uint64_t control = static_cast<uint16_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(chunk, belowSpace), belowSpace)));
+            block.control |= control << shift;
+        }
+        return block;
+    }
+#else
+    Block classify(const char* data)
+    {
+        Block block = {};
+        for (int i = 0; i < 64; ++i)
+        {
+            uint64_t bit = 1ULL << i;
+            char c = data[i];
+            switch (c)
+            {
+                case '"': block.quote |= bit; break;
+                case '\\': block.backslash |= bit; break;
+                case '{': case '}': case '[': case ']': case ':': case ',': block.op |= bit; break;
+                case ' ': case '\t': case '\n': case '\r': block.whitespace |= bit; break;
+            }
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                block.control |= bit;
+            }
+        }
+        return block;
+    }
+#endif
+
+    /* Bit i becomes the xor of bits 0..i: set from an opening quote up to, not including, its closing one */
+    uint64_t prefixXor(uint64_t bits)
+    {
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+        return bits;
+    }
+
+    /*
+     * First pass: positions of quotes, structural characters and the first
+     * byte of every number or literal, in order. False on an unterminated
+     * string or a control character inside one. `index` only grows; the
+     * first `count` entries are this text's.
+     */
+    bool indexStructurals(std::string_view text, std::vector<uint32_t>& index, size_t& count)
+    {
+        count = 0;
+        uint64_t prevEscaped = 0;
+        uint64_t prevInString = 0;
+        uint64_t prevScalar = 0;
+        uint64_t errors = 0;
+
+        for (size_t base = 0; base < text.size(); base += 64)
+        {
+            const char* data = text.data() + base;
+            char padded[64];
+            if (text.size() - base < 64)
+            {
+                std::memset(padded, ' ', sizeof(padded));
+                std::memcpy(padded, data, text.size() - base);
+                data = padded;
+            }
+            Block block = classify(data);
+
+            /* A backslash escapes the next byte unless it is itself escaped: odd-length runs escape */
+            uint64_t backslash = block.backslash & ~prevEscaped;
+            uint64_t followsEscape = backslash << 1 | prevEscaped;
+            uint64_t oddStarts = backslash & ~EVEN_BITS & ~followsEscape;
+            uint64_t evenRunEnds;
+            prevEscaped = __builtin_add_overflow(oddStarts, backslash, &evenRunEnds);
+            uint64_t escaped = (EVEN_BITS ^ (evenRunEnds << 1)) & followsEscape;
+
+            uint64_t quote = block.quote & ~escaped;
+            uint64_t inString = prefixXor(quote) ^ prevInString;
+            prevInString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+            errors |= block.control & inString;
+
+            uint64_t scalar = ~(block.op | block.whitespace | block.quote);
+            uint64_t scalarStarts = scalar & ~(scalar << 1 | prevScalar);
+            prevScalar = scalar >> 63;
+
+            uint64_t structurals = ((block.op | scalarStarts) & ~inString) | quote;
+            if (index.size() < count + 64)
+            {
+                index.resize(std::max(index.size() * 2, count + 64));
+            }
+            uint32_t* out = index.data() + count;
+            while (structurals)
+            {
+                *out++ = static_cast<uint32_t>(base + __builtin_ctzll(structurals));
+                structurals &= structurals - 1;
+            }
+            count = out - index.data();
+        }
+        /* The padding of the last block is spaces, never structural */
+        return errors == 0 && prevInString == 0;
+    }
+
+    constexpr std::array<bool, 256> makeScalarEnds()
+    {
+        std::array<bool, 256> ends{};
+        for (char c : std::string_view(" \t\n\r,:[]{}\""))
+        {
+            ends[static_cast<uint8_t>(c)] = true;
+        }
+        return ends;
+    }
+
+    /* Bytes that end a number or literal */
+    constexpr std::array<bool, 256> ENDS_SCALAR = makeScalarEnds();
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    /* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+    bool isNumber(std::string_view token)
+    {
+        size_t i = 0;
+        size_t size = token.size();
+        if (i < size && token[i] == '-')
+        {
+            ++i;
+        }
+        if (i == size || !isDigit(token[i]))
+        {
+            return false;
+        }
+        if (token[i++] != '0')
+        {
+            while (i < size && isDigit(token[i]))
+            {
+                ++i;
+            }
+        }
+        if (i < size && token[i] == '.')
+        {
+            if (++i == size || !isDigit(token[i]))
+            {
+                return false;
+            }
+            while (i < size && isDigit(token[i]))
+            {
+                ++i;
+            }
+        }
+        if (i < size && (token[i] == 'e' || token[i] == 'E'))
+        {
+            if (++i < size && (token[i] == '+' || token[i] == '-'))
+            {
+                ++i;
+            }
+            if (i == size || !isDigit(token[i]))
+            {
+                return false;
+            }
+            while (i < size && isDigit(token[i]))
+            {
+                ++i;
+            }
+        }
+        return i == size;
+    }
+
+    int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    /* Four hex digits at `in`, or -1 */
+    int32_t readHex4(const char* in, const char* end)
+    {
+        if (end - in < 4)
+        {
+            return -1;
+        }
+        int32_t unit = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            int digit = hexDigit(in[i]);
+            if (digit < 0)
+            {
+                return -1;
+            }
+            unit = unit << 4 | digit;
+        }
+        return unit;
+    }
+
+    char* appendUtf8(uint32_t codePoint, char* out)
+    {
+        if (codePoint < 0x80)
+        {
+            *out++ = static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800)
+        {
+            *out++ = static_cast<char>(0xC0 | codePoint >> 6);
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            *out++ = static_cast<char>(0xE0 | codePoint >> 12);
+            *out++ = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            *out++ = static_cast<char>(0xF0 | codePoint >> 18);
+            *out++ = static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        return out;
+    }
+
+    /* Decodes the escapes of `raw` into `out`, which is at least as long; returns the end, or nullptr */
+    char* unescape(std::string_view raw, char* out)
+    {
+        const char* in = raw.data();
+        const char* end = in + raw.size();
+        while (in < end)
+        {
+            const char* backslash = static_cast<const char*>(std::memchr(in, '\\', end - in));
+            if (!backslash)
+            {
+                backslash = end;
+            }
+            std::memcpy(out, in, backslash - in);
+            out += backslash - in;
+            in = backslash;
+            if (in == end)
+            {
+                break;
+            }
+            if (++in == end)
+            {
+                return nullptr;
+            }
+            switch (*in++)
+            {
+                case '"': *out++ = '"'; break;
+                case '\\': *out++ = '\\'; break;
+                case '/': *out++ = '/'; break;
+                case 'b': *out++ = '\b'; break;
+                case 'f': *out++ = '\f'; break;
+                case 'n': *out++ = '\n'; break;
+                case 'r': *out++ = '\r'; break;
+                case 't': *out++ = '\t'; break;
+                case 'u':
+                {
+                    int32_t unit = readHex4(in, end);
+                    if (unit < 0 || (unit >= 0xDC00 && unit <= 0xDFFF))
+                    {
+                        return nullptr;
+                    }
+                    in += 4;
+                    uint32_t codePoint = static_cast<uint32_t>(unit);
+                    if (unit >= 0xD800 && unit <= 0xDBFF)
+                    {
+                        /* A high surrogate only counts with its low half right behind it */
+                        int32_t low = end - in >= 6 && in[0] == '\\' && in[1] == 'u' ? readHex4(in + 2, end) : -1;
+                        if (low < 0xDC00 || low > 0xDFFF)
+                        {
+                            return nullptr;
+                        }
+                        in += 6;
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (static_cast<uint32_t>(low) - 0xDC00);
+                    }
+                    out = appendUtf8(codePoint, out);
+                    break;
+                }
+                default:
+                    return nullptr;
+            }
+        }
+        return out;
+    }
+
+    /* Scratch space of the passes, kept per thread across documents */
+    struct Scratch
+    {
+        std::vector<uint32_t> index;
+        std::vector<JsonValue> elements;
+        std::vector<JsonMember> members;
+    };
+
+    thread_local Scratch scratch;
+}
+
+/* Second pass: recursive descent over the structural positions */
+class JsonDocumentBuilder
+{
+public:
+    JsonDocumentBuilder(std::string_view text, std::span<const uint32_t> index, std::pmr::memory_resource* resource)
+        : text(text), index(index), resource(resource)
+    {
+    }
+
+    const JsonValue* build()
+    {
+        JsonValue* root = allocate<JsonValue>(1);
+        *root = JsonValue();
+        if (!parseValue(*root, 0) || next < index.size())
+        {
+            return nullptr;
+        }
+        return root;
+    }
+
+private:
+    std::string_view text;
+    std::span<const uint32_t> index;
+    std::pmr::memory_resource* resource;
+    size_t next = 0;
+
+    template<class T>
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(resource->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /* The structural character at the next position, or 0 at the end */
+    char peek() const
+    {
+        return next < index.size() ? text[index[next]] : 0;
+    }
+
+    bool parseValue(JsonValue& value, size_t depth)
+    {
+        if (next == index.size())
+        {
+            return false;
+        }
+        uint32_t at = index[next++];
+        switch (text[at])
+        {
+            case '{':
+                return depth < MAX_DEPTH && parseObject(value, depth + 1);
+            case '[':
+                return depth < MAX_DEPTH && parseArray(value, depth + 1);
+            case '"':
+                return parseString(at, value);
+            case '}': case ']': case ':': case ',':
+                return false;
+            default:
+                return parseScalar(at, value);
+        }
+    }
+
+    bool parseScalar(uint32_t at, JsonValue& value)
+    {
+        size_t end = at + 1;
+        while (end < text.size() && !ENDS_SCALAR[static_cast<uint8_t>(text[end])])
+        {
+            ++end;
+        }
+        std::string_view token = text.substr(at, end - at);
+        if (token == "true" || token == "false")
+        {
+            value.type = JsonValue::Type::Bool;
+            value.boolean = token[0] == 't';
+            return true;
+        }
+        if (token == "null")
+        {
+            value.type = JsonValue::Type::Null;
+            return true;
+        }
+        if (!isNumber(token))
+        {
+            return false;
+        }
+        value.type = JsonValue::Type::Number;
+        value.text = token.data();
+        value.count = static_cast<uint32_t>(token.size());
+        return true;
+    }
+
+    bool parseString(uint32_t open, JsonValue& value)
+    {
+        /* Unescaped quotes come in pairs, so the next position is the closing one */
+        uint32_t close = index[next++];
+        std::string_view raw = text.substr(open + 1, close - open - 1);
+        value.type = JsonValue::Type::String;
+        if (!std::memchr(raw.data(), '\\', raw.size()))
+        {
+            value.text = raw.data();
+            value.count = static_cast<uint32_t>(raw.size());
+            return true;
+        }
+        /* Decoding never makes a string longer */
+        char* decoded = allocate<char>(raw.size());
+        char* end = unescape(raw, decoded);
+        if (!end)
+        {
+            return false;
+        }
+        value.text = decoded;
+        value.count = static_cast<uint32_t>(end - decoded);
+        return true;
+    }
+
+    bool parseArray(JsonValue& value, size_t depth)
+    {
+        value.type = JsonValue::Type::Array;
+        std::vector<JsonValue>& elements = scratch.elements;
+        size_t first = elements.size();
+        if (peek() == ']')
+        {
+            ++next;
+            return true;
+        }
+        while (true)
+        {
+            JsonValue element;
+            if (!parseValue(element, depth))
+            {
+                return false;
+            }
+            elements.push_back(element);
+            char c = peek();
+            ++next;
+            if (c == ']')
+            {
+                break;
+            }
+            if (c != ',')
+            {
+                return false;
+            }
+        }
+        size_t count = elements.size() - first;
+        JsonValue* stored = allocate<JsonValue>(count);
+        std::uninitialized_copy(elements.begin() + first, elements.end(), stored);
+        elements.resize(first);
+        value.elements = stored;
+        value.count = static_cast<uint32_t>(count);
+        return true;
+    }
+
+    bool parseObject(JsonValue& value, size_t depth)
+    {
+        value.type = JsonValue::Type::Object;
+        std::vector<JsonMember>& members = scratch.members;
+        size_t first = members.size();
+        if (peek() == '}')
+        {
+            ++next;
+            return true;
+        }
+        while (true)
+        {
+            JsonMember member;
+            if (peek() != '"' || !parseString(index[next++], member.value) || peek() != ':')
+            {
+                return false;
+            }
+            member.key = member.value.asString();
+            ++next;
+            member.value = JsonValue();
+            if (!parseValue(member.value, depth))
+            {
+                return false;
+            }
+            members.push_back(member);
+            char c = peek();
+            ++next;
+            if (c == '}')
+            {
+                break;
+            }
+            if (c != ',')
+            {
+                return false;
+            }
+        }
+        size_t count = members.size() - first;
+        JsonMember* stored = allocate<JsonMember>(count);
+        std::uninitialized_copy(members.begin() + first, members.end(), stored);
+        members.resize(first);
+        value.fields = stored;
+        value.count = static_cast<uint32_t>(count);
+        return true;
+    }
+};
+
+const JsonValue*
+parseJson(std::string_view text, std::pmr::memory_resource* resource)
+{
+    size_t count = 0;
+    if (text.size() > std::numeric_limits<uint32_t>::max() || !indexStructurals(text, scratch.index, count))
+    {
+        return nullptr;
+    }
+    const JsonValue* root = JsonDocumentBuilder(text, std::span(scratch.index.data(), count), resource).build();
+    /* A failed parse leaves partial containers behind */
+    scratch.elements.clear();
+    scratch.members.clear();
+    return root;
+}
+
+bool
+JsonValue::asBool(bool fallback) const
+{
+    return type == Type::Bool ? boolean : fallback;
+}
+
+double
+JsonValue::asDouble(double fallback) const
+{
+    if (type != Type::Number)
+    {
+        return fallback;
+    }
+    double number = fallback;
+    std::from_chars(text, text + count, number);
+    return number;
+}
+
+int64_t
+JsonValue::asInt(int64_t fallback) const
+{
+    if (type != Type::Number)
+    {
+        return fallback;
+    }
+    int64_t number = 0;
+    auto result = std::from_chars(text, text + count, number);
+    if (result.ec == std::errc() && result.ptr == text + count)
+    {
+        return number;
+    }
+    double real = asDouble();
+    if (!(real > -9.3e18 && real < 9.3e18))
+    {
+        return real < 0 ? std::numeric_limits<int64_t>::min() : std::numeric_limits<int64_t>::max();
+    }
+    return static_cast<int64_t>(real);
+}
+
+std::string_view
+JsonValue::asString(std::string_view fallback) const
+{
+    return type == Type::String ? std::string_view(text, count) : fallback;
+}
+
+size_t
+JsonValue::size() const
+{
+    return type == Type::Array || type == Type::Object ? count : 0;
+}
+
+const JsonValue&
+JsonValue::operator[](size_t index) const
+{
+    return type == Type::Array && index < count ? elements[index] : NULL_VALUE;
+}
+
+const JsonValue&
+JsonValue::operator[](std::string_view key) const
+{
+    const JsonValue* member = find(key);
+    return member ? *member : NULL_VALUE;
+}
+
+const JsonValue*
+JsonValue::find(std::string_view key) const
+{
+    for (const JsonMember& member : members())
+    {
+        if (member.key == key)
+        {
+            return &member.value;
+        }
+    }
+    return nullptr;
+}
+
+std::span<const JsonValue>
+JsonValue::items() const
+{
+    return type == Type::Array ? std::span<const JsonValue>(elements, count) : std::span<const JsonValue>();
+}
+
+std::span<const JsonMember>
+JsonValue::members() const
+{
+    return type == Type::Object ? std::span<const JsonMember>(fields, count) : std::span<const JsonMember>();
+}
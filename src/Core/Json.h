@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+
+struct JsonMember;
+
+/*
+ * One node of a parsed JSON document. Nodes, and strings that contained
+ * escapes, live in the memory resource the document was parsed into; other
+ * strings and all numbers are views into the parsed text, which has to
+ * outlive the document. Numbers are converted when they are read.
+ */
+class JsonValue
+{
+public:
+    enum class Type : uint8_t
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Type::Null;
+
+    bool isNull() const { return type == Type::Null; }
+    bool isBool() const { return type == Type::Bool; }
+    bool isNumber() const { return type == Type::Number; }
+    bool isString() const { return type == Type::String; }
+    bool isArray() const { return type == Type::Array; }
+    bool isObject() const { return type == Type::Object; }
+
+    /* `fallback` when the value is of another type */
+    bool asBool(bool fallback = false) const;
+    double asDouble(double fallback = 0) const;
+    /* Numbers with a fraction or exponent are truncated */
+    int64_t asInt(int64_t fallback = 0) const;
+    std::string_view asString(std::string_view fallback = {}) const;
+
+    /* Elements of an array or members of an object, 0 for anything else */
+    size_t size() const;
+    /* A null value when out of range or not an array */
+    const JsonValue& operator[](size_t index) const;
+    /* First member named `key`, or a null value */
+    const JsonValue& operator[](std::string_view key) const;
+    /* nullptr when there is no such member */
+    const JsonValue* find(std::string_view key) const;
+    std::span<const JsonValue> items() const;
+    std::span<const JsonMember> members() const;
+
+private:
+    friend class JsonDocumentBuilder;
+
+    uint32_t count = 0;     /* String length, element or member count */
+    union
+    {
+        const char* text = nullptr;
+        const JsonValue* elements;
+        const JsonMember* fields;
+        bool boolean;
+    };
+};
+
+struct JsonMember
+{
+    std::string_view key;
+    JsonValue value;
+};
+
+/*
+ * Parses `text` in two passes, after simdjson. The first classifies 64 bytes
+ * at a time into bitmasks (quotes, backslashes, structural characters,
+ * whitespace), resolves escapes and string spans with bit arithmetic, and
+ * records the position of every structural character and value start. The
+ * second walks those positions to build the document, without looking at
+ * whitespace or string contents again. Classification uses SSE2 where
+ * available and a byte loop otherwise.
+ *
+ * Returns nullptr unless `text` is exactly one valid RFC 8259 value; strings
+ * are not checked for well-formed UTF-8. Nesting is limited to 1024 levels.
+ */
+const JsonValue* parseJson(std::string_view text, std::pmr::memory_resource* resource);
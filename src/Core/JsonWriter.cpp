@@ -0,0 +1,145 @@
+#include "JsonWriter.h"
+
+#include <cmath>
+#include "ByteScan.h"
+
+namespace
+{
+    /* Characters a JSON string has to escape: quote, backslash and the controls below 0x20 */
+    constexpr ByteSet JSON_SPECIAL("\"\\", 0x20);
+
+    void appendEscaped(char c, std::pmr::string& out)
+    {
+        switch (c)
+        {
+            case '"': out.append("\\\""); return;
+            case '\\': out.append("\\\\"); return;
+            case '\b': out.append("\\b"); return;
+            case '\f': out.append("\\f"); return;
+            case '\n': out.append("\\n"); return;
+            case '\r': out.append("\\r"); return;
+            case '\t': out.append("\\t"); return;
+        }
+        constexpr char HEX[] = "0123456789abcdef";
+        char escaped[6] = {'\\', 'u', '0', '0', HEX[(c >> 4) & 0xF], HEX[c & 0xF]};
+        out.append(escaped, sizeof(escaped));
+    }
+}
+
+JsonWriter&
+JsonWriter::object()
+{
+    separate();
+    out.push_back('{');
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::endObject()
+{
+    out.push_back('}');
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::array()
+{
+    separate();
+    out.push_back('[');
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::endArray()
+{
+    out.push_back(']');
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::key(std::string_view name)
+{
+    separate();
+    escape(name, out);
+    out.push_back(':');
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value(std::string_view str)
+{
+    separate();
+    escape(str, out);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value(bool boolean)
+{
+    separate();
+    out.append(boolean ? "true" : "false");
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value(double number)
+{
+    if (!std::isfinite(number))
+    {
+        return null();
+    }
+    separate();
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    out.append(digits, result.ptr - digits);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::null()
+{
+    separate();
+    out.append("null");
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::raw(std::string_view json)
+{
+    separate();
+    out.append(json);
+    return *this;
+}
+
+void
+JsonWriter::escape(std::string_view str, std::pmr::string& out)
+{
+    out.reserve(out.size() + str.size() + 2);
+    out.push_back('"');
+    while (true)
+    {
+        size_t clean = cleanPrefix(str.data(), str.size(), JSON_SPECIAL);
+        out.append(str.data(), clean);
+        if (clean == str.size())
+        {
+            break;
+        }
+        appendEscaped(str[clean], out);
+        str.remove_prefix(clean + 1);
+    }
+    out.push_back('"');
+}
+
+void
+JsonWriter::separate()
+{
+    if (out.empty())
+    {
+        return;
+    }
+    char last = out.back();
+    if (last != '{' && last != '[' && last != ':')
+    {
+        out.push_back(',');
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/*
+ * Streaming JSON encoder appending straight to a string, normally a
+ * response body in the request arena: no DOM and no intermediate strings.
+ * Commas and colons follow from what was written last, numbers go through
+ * std::to_chars, and strings are scanned for characters to escape 16 bytes
+ * at a time where SSE2 is available.
+ *
+ *     res.jsonWriter().object().key("id").value(42).key("tags").array().value("a").endArray().endObject();
+ *
+ * Nesting is the caller's job: every object() / array() needs its end.
+ */
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::pmr::string& out) : out(out) {}
+
+    JsonWriter& object();
+    JsonWriter& endObject();
+    JsonWriter& array();
+    JsonWriter& endArray();
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& value(std::string_view str);
+    JsonWriter& value(const char* str) { return value(std::string_view(str)); }
+    JsonWriter& value(char c) { return value(std::string_view(&c, 1)); }
+    JsonWriter& value(bool boolean);
+    JsonWriter& value(double number);       /* NaN and infinities have no JSON form and are written as null */
+    /* Not char: a character is written as a string */
+    template<class Integer>
+        requires std::is_integral_v<Integer> && (!std::is_same_v<Integer, char>)
+    JsonWriter& value(Integer number);
+    JsonWriter& null();
+    /* Already-encoded JSON, written as one value */
+    JsonWriter& raw(std::string_view json);
+
+    /* Appends `str` as a quoted, escaped JSON string */
+    static void escape(std::string_view str, std::pmr::string& out);
+
+private:
+    std::pmr::string& out;
+
+    /* A comma unless this is the first thing in its container or follows a key */
+    void separate();
+};
+
+template<class Integer>
+    requires std::is_integral_v<Integer> && (!std::is_same_v<Integer, char>)
+JsonWriter&
+JsonWriter::value(Integer number)
+{
+    separate();
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    out.append(digits, result.ptr - digits);
+    return *this;
+}
@@ -0,0 +1,483 @@
+#include "Multipart.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    std::string_view trim(std::string_view str)
+    {
+        size_t start = str.find_first_not_of(" \t");
+        if (start == std::string_view::npos)
+        {
+            return {};
+        }
+        size_t end = str.find_last_not_of(" \t");
+        return str.substr(start, end - start + 1);
+    }
+
+    /* Walks `key=value` / `key="quoted value"` parameters separated by ';' */
+    template<class Visit>
+    void forEachParameter(std::string_view params, Visit visit)
+    {
+        size_t pos = 0;
+        while (pos < params.size())
+        {
+            size_t keyEnd = params.find_first_of("=;", pos);
+            std::string_view key = trim(params.substr(pos, keyEnd - pos));
+            if (keyEnd == std::string_view::npos || params[keyEnd] == ';')
+            {
+                pos = keyEnd == std::string_view::npos ? params.size() : keyEnd + 1;
+                continue;
+            }
+
+            std::string value;
+            pos = keyEnd + 1;
+            while (pos < params.size() && (params[pos] == ' ' || params[pos] == '\t'))
+            {
+                ++pos;
+            }
+            if (pos < params.size() && params[pos] == '"')
+            {
+                for (++pos; pos < params.size() && params[pos] != '"'; ++pos)
+                {
+                    if (params[pos] == '\\' && pos + 1 < params.size())
+                    {
+                        ++pos;
+                    }
+                    value += params[pos];
+                }
+                pos = params.find(';', pos);
+            }
+            else
+            {
+                size_t valueEnd = params.find(';', pos);
+                value = trim(params.substr(pos, valueEnd - pos));
+                pos = valueEnd;
+            }
+            visit(key, value);
+            pos = pos == std::string_view::npos ? params.size() : pos + 1;
+        }
+    }
+}
+
+std::string_view
+MultipartParser::boundaryOf(std::string_view contentType)
+{
+    size_t paramsStart = contentType.find(';');
+    if (paramsStart == std::string_view::npos)
+    {
+        return {};
+    }
+
+    /* Boundaries may not contain quotes or backslashes, so the raw text is the value */
+    std::string_view params = contentType.substr(paramsStart + 1);
+    while (!params.empty())
+    {
+        size_t end = params.find(';');
+        std::string_view param = trim(params.substr(0, end));
+        if (param.size() > 9 && equalsIgnoreCase(param.substr(0, 9), "boundary="))
+        {
+            std::string_view value = param.substr(9);
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+            {
+                value = value.substr(1, value.size() - 2);
+            }
+            return value;
+        }
+        params = end == std::string_view::npos ? std::string_view() : params.substr(end + 1);
+    }
+    return {};
+}
+
+MultipartParser::MultipartParser(std::string_view boundary)
+    : state(boundary.empty() ? State::Error : State::Preamble), delimiter("\r\n--")
+{
+    delimiter.append(boundary);
+
+    /* Horspool shift table: distance from a byte's last occurrence to the end of the pattern */
+    skip.fill(delimiter.size());
+    for (size_t i = 0; i + 1 < delimiter.size(); ++i)
+    {
+        skip[static_cast<unsigned char>(delimiter[i])] = delimiter.size() - 1 - i;
+    }
+
+    /* The first delimiter needs no leading CRLF */
+    carry = "\r\n";
+}
+
+bool
+MultipartParser::feed(std::string_view data)
+{
+    while (!data.empty())
+    {
+        size_t used = 0;
+        switch (state)
+        {
+            case State::Preamble:
+            case State::Body:
+                used = scanBody(data);
+                break;
+            case State::AfterDelimiter:
+            case State::ExpectDash:
+            case State::ExpectLf:
+                used = afterDelimiter(data);
+                break;
+            case State::Headers:
+                used = readHeaders(data);
+                break;
+            case State::Done:
+                /* Epilogue, ignored */
+                return true;
+            case State::Error:
+                return false;
+        }
+        data.remove_prefix(used);
+    }
+    return state != State::Error;
+}
+
+size_t
+MultipartParser::search(std::string_view haystack) const
+{
+    const size_t length = delimiter.size();
+    size_t pos = 0;
+    while (pos + length <= haystack.size())
+    {
+        size_t i = length - 1;
+        while (haystack[pos + i] == delimiter[i])
+        {
+            if (i == 0)
+            {
+                return pos;
+            }
+            --i;
+        }
+        pos += skip[static_cast<unsigned char>(haystack[pos + length - 1])];
+    }
+    return std::string_view::npos;
+}
+
+size_t
+MultipartParser::scan(std::string_view data, bool& matched)
+{
+    size_t found = search(data);
+    matched = found != std::string_view::npos;
+
+    /* Without a match, hold back the shortest tail that could still begin a delimiter */
+    size_t emit = found;
+    if (!matched)
+    {
+        emit = data.size();
+        size_t tailStart = data.size() >= delimiter.size() ? data.size() - delimiter.size() + 1 : 0;
+        for (size_t i = tailStart; i < data.size(); ++i)
+        {
+            if (data[i] == '\r' && delimiter.compare(0, data.size() - i, data.substr(i)) == 0)
+            {
+                emit = i;
+                break;
+            }
+        }
+    }
+
+    if (state == State::Body && emit > 0 && partData)
+    {
+        partData(part, data.substr(0, emit));
+    }
+    return matched ? found + delimiter.size() : emit;
+}
+
+size_t
+MultipartParser::scanBody(std::string_view data)
+{
+    bool matched = false;
+    size_t used = 0;
+
+    if (carry.empty())
+    {
+        used = scan(data, matched);
+        if (!matched)
+        {
+            carry.assign(data.substr(used));
+            return data.size();
+        }
+    }
+    else
+    {
+        /* Borrow enough input to complete any delimiter that starts in the carried bytes */
+        size_t previous = carry.size();
+        size_t borrowed = std::min(data.size(), delimiter.size());
+        carry.append(data.substr(0, borrowed));
+        used = scan(carry, matched);
+        if (!matched && used < previous)
+        {
+            /* Input too short to decide; it all stays carried */
+            carry.erase(0, used);
+            return borrowed;
+        }
+        carry.clear();
+        used -= previous;
+        if (!matched)
+        {
+            return used;
+        }
+    }
+
+    if (state == State::Body && partEnd)
+    {
+        partEnd(part);
+    }
+    state = State::AfterDelimiter;
+    return used;
+}
+
+size_t
+MultipartParser::afterDelimiter(std::string_view data)
+{
+    size_t pos = 0;
+    while (pos < data.size() && (state == State::AfterDelimiter || state == State::ExpectDash || state == State::ExpectLf))
+    {
+        char c = data[pos++];
+        if (state == State::AfterDelimiter)
+        {
+            if (c == '-')
+            {
+                state = State::ExpectDash;
+            }
+            else if (c == '\r')
+            {
+                state = State::ExpectLf;
+            }
+            else if (c != ' ' && c != '\t')
+            {
+                state = State::Error;
+            }
+        }
+        else if (state == State::ExpectDash)
+        {
+            state = c == '-' ? State::Done : State::Error;
+        }
+        else if (c == '\n')
+        {
+            state = State::Headers;
+            headerBlock = "\r\n";
+        }
+        else
+        {
+            state = State::Error;
+        }
+    }
+    return pos;
+}
+
+size_t
+MultipartParser::readHeaders(std::string_view data)
+{
+    size_t searchFrom = headerBlock.size() >= 3 ? headerBlock.size() - 3 : 0;
+    size_t previous = headerBlock.size();
+    size_t take = std::min(data.size(), MaxHeaderSize + 4 - std::min(previous, MaxHeaderSize + 4));
+    headerBlock.append(data.substr(0, take));
+
+    size_t end = headerBlock.find("\r\n\r\n", searchFrom);
+    if (end == std::string::npos)
+    {
+        if (headerBlock.size() >= MaxHeaderSize + 4)
+        {
+            state = State::Error;
+        }
+        return take;
+    }
+
+    size_t used = end + 4 - previous;
+    headerBlock.resize(end + 2);
+    if (!parseHeaders())
+    {
+        state = State::Error;
+        return used;
+    }
+
+    state = State::Body;
+    if (partBegin)
+    {
+        partBegin(part);
+    }
+    return used;
+}
+
+bool
+MultipartParser::parseHeaders()
+{
+    part = MultipartPart();
+    bool disposition = false;
+
+    std::string_view block(headerBlock);
+    size_t pos = 2;
+    while (pos < block.size())
+    {
+        size_t lineEnd = block.find("\r\n", pos);
+        std::string_view line = block.substr(pos, lineEnd - pos);
+        pos = lineEnd + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos)
+        {
+            return false;
+        }
+        std::string_view name = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+
+        if (equalsIgnoreCase(name, "Content-Disposition"))
+        {
+            disposition = true;
+            size_t paramsStart = value.find(';');
+            if (paramsStart == std::string_view::npos)
+            {
+                continue;
+            }
+            forEachParameter(value.substr(paramsStart + 1), [this](std::string_view key, std::string& param)
+            {
+                if (equalsIgnoreCase(key, "name"))
+                {
+                    part.name = std::move(param);
+                }
+                else if (equalsIgnoreCase(key, "filename"))
+                {
+                    part.filename = std::move(param);
+                }
+            });
+        }
+        else if (equalsIgnoreCase(name, "Content-Type"))
+        {
+            part.contentType = value;
+        }
+    }
+    return disposition;
+}
+
+MultipartForm::MultipartForm(std::string_view contentType, std::string directory)
+    : parser(MultipartParser::boundaryOf(contentType)), directory(std::move(directory)), fileFd(-1),
+      fieldBytes(0), failed(false)
+{
+    /* Client errors are reported through done(); only server-side faults are logged */
+    if (parser.failed())
+    {
+        failed = true;
+        return;
+    }
+
+    parser.onPartBegin([this](const MultipartPart& part) { beginPart(part); });
+    parser.onPartData([this](const MultipartPart& part, std::string_view data) { appendPart(part, data); });
+    parser.onPartEnd([this](const MultipartPart&) { endPart(); });
+}
+
+MultipartForm::~MultipartForm()
+{
+    endPart();
+    if (!done())
+    {
+        /* Don't leave half-received uploads behind */
+        for (const File& file : files)
+        {
+            unlink(file.path.c_str());
+        }
+    }
+}
+
+bool
+MultipartForm::feed(std::string_view data)
+{
+    if (failed)
+    {
+        return false;
+    }
+    if (!parser.feed(data))
+    {
+        failed = true;
+    }
+    return !failed;
+}
+
+std::string_view
+MultipartForm::field(std::string_view name) const
+{
+    auto it = fields.find(name);
+    return it != fields.end() ? std::string_view(it->second) : std::string_view();
+}
+
+void
+MultipartForm::beginPart(const MultipartPart& part)
+{
+    if (failed)
+    {
+        return;
+    }
+
+    if (!part.isFile())
+    {
+        fieldBytes += part.name.size();
+        fields.try_emplace(part.name);
+        return;
+    }
+
+    std::string path = directory + "/upload-XXXXXX";
+    fileFd = mkostemp(path.data(), O_CLOEXEC);
+    if (fileFd < 0)
+    {
+        std::cerr << "Could not create upload file in " << directory << "\n";
+        failed = true;
+        return;
+    }
+    files.push_back(File{part.name, part.filename, part.contentType, std::move(path), 0});
+}
+
+void
+MultipartForm::appendPart(const MultipartPart& part, std::string_view data)
+{
+    if (failed)
+    {
+        return;
+    }
+
+    if (!part.isFile())
+    {
+        fieldBytes += data.size();
+        if (fieldBytes > MaxFieldBytes)
+        {
+            failed = true;
+            return;
+        }
+        fields[part.name].append(data);
+        return;
+    }
+
+    while (!data.empty())
+    {
+        ssize_t written = write(fileFd, data.data(), data.size());
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "Could not write upload file " << files.back().path << "\n";
+            failed = true;
+            return;
+        }
+        files.back().size += static_cast<uint64_t>(written);
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+void
+MultipartForm::endPart()
+{
+    if (fileFd >= 0)
+    {
+        close(fileFd);
+        fileFd = -1;
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ReqRes.h"
+
+struct MultipartPart
+{
+    std::string name;
+    std::string filename;
+    std::string contentType;
+
+    bool isFile() const { return !filename.empty(); }
+};
+
+/*
+ * Incremental multipart/form-data parser. Body bytes can be fed in pieces of
+ * any size; part data is handed on as it is found, mostly as views into the
+ * fed input. Only a part's header block and a delimiter's worth of bytes
+ * around a piece boundary are ever buffered, so memory stays bounded no
+ * matter how large the parts are. Delimiters are located with
+ * Boyer-Moore-Horspool.
+ */
+class MultipartParser
+{
+public:
+    using PartCallback = std::function<void(const MultipartPart& part)>;
+    using DataCallback = std::function<void(const MultipartPart& part, std::string_view data)>;
+
+    static constexpr size_t MaxHeaderSize = 8 * 1024;
+
+    /* The boundary parameter of a multipart Content-Type, empty if there is none */
+    static std::string_view boundaryOf(std::string_view contentType);
+
+    explicit MultipartParser(std::string_view boundary);
+
+    void onPartBegin(PartCallback callback) { partBegin = std::move(callback); }
+    void onPartData(DataCallback callback) { partData = std::move(callback); }
+    void onPartEnd(PartCallback callback) { partEnd = std::move(callback); }
+
+    /* False once the input is malformed */
+    bool feed(std::string_view data);
+
+    /* True after the closing delimiter */
+    bool done() const { return state == State::Done; }
+    bool failed() const { return state == State::Error; }
+
+private:
+    enum class State
+    {
+        Preamble,
+        AfterDelimiter,
+        ExpectDash,
+        ExpectLf,
+        Headers,
+        Body,
+        Done,
+        Error
+    };
+
+    State state;
+    std::string delimiter;                  /* CRLF "--" boundary */
+    std::array<size_t, 256> skip;
+    std::string carry;                      /* Input that may start a delimiter */
+    std::string headerBlock;
+    MultipartPart part;
+
+    PartCallback partBegin;
+    DataCallback partData;
+    PartCallback partEnd;
+
+    size_t search(std::string_view haystack) const;
+    size_t scan(std::string_view data, bool& matched);
+    size_t scanBody(std::string_view data);
+    size_t afterDelimiter(std::string_view data);
+    size_t readHeaders(std::string_view data);
+    bool parseHeaders();
+};
+
+/*
+ * Collects a multipart form: small fields in memory, file parts written to
+ * temporary files under `directory` as they arrive. The files are left for
+ * the caller to move or delete, unless the form was incomplete.
+ */
+class MultipartForm
+{
+public:
+    struct File
+    {
+        std::string name;
+        std::string filename;
+        std::string contentType;
+        std::string path;   /* Temporary file holding the upload */
+        uint64_t size = 0;
+    };
+
+    /* Limit on all field names and values together */
+    static constexpr size_t MaxFieldBytes = 64 * 1024;
+
+    MultipartForm(std::string_view contentType, std::string directory);
+    ~MultipartForm();
+
+    MultipartForm(const MultipartForm&) = delete;
+    MultipartForm& operator=(const MultipartForm&) = delete;
+
+    bool feed(std::string_view data);
+    /* True if the form was complete and every part was stored */
+    bool done() const { return parser.done() && !failed; }
+
+    std::string_view field(std::string_view name) const;
+
+public:
+    std::unordered_map<std::string, std::string, StringHash, std::equal_to<>> fields;
+    std::vector<File> files;
+
+private:
+    MultipartParser parser;
+    std::string directory;
+    int fileFd;
+    size_t fieldBytes;
+    bool failed;
+
+    void beginPart(const MultipartPart& part);
+    void appendPart(const MultipartPart& part, std::string_view data);
+    void endPart();
+};
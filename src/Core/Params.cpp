@@ -0,0 +1,174 @@
+#include "Params.h"
+
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    std::string_view trimSpaces(std::string_view str)
+    {
+        size_t first = str.find_first_not_of(' ');
+        size_t last = str.find_last_not_of(' ');
+        return first == std::string_view::npos ? std::string_view() : str.substr(first, last - first + 1);
+    }
+}
+
+Params::Params(Syntax syntax, std::pmr::memory_resource* resource)
+    : syntax(syntax), parsed(true), decoded(resource), pairs(resource)
+{
+}
+
+void
+Params::assign(std::string_view text)
+{
+    source = text;
+    parsed = text.empty();
+    decoded.clear();
+    pairs.clear();
+}
+
+std::string_view
+Params::get(std::string_view key) const
+{
+    parse();
+    for (const Pair& pair : pairs)
+    {
+        if (pair.first == key)
+        {
+            return pair.second;
+        }
+    }
+    return {};
+}
+
+std::pmr::vector<std::string_view>
+Params::getAll(std::string_view key) const
+{
+    parse();
+    std::pmr::vector<std::string_view> values(pairs.get_allocator());
+    for (const Pair& pair : pairs)
+    {
+        if (pair.first == key)
+        {
+            values.push_back(pair.second);
+        }
+    }
+    return values;
+}
+
+bool
+Params::has(std::string_view key) const
+{
+    parse();
+    for (const Pair& pair : pairs)
+    {
+        if (pair.first == key)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t
+Params::decode(std::string_view in, char* out, bool plusIsSpace)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < in.size())
+    {
+#if defined(__SSE2__)
+        /* Copy 16-byte runs with nothing to decode in one go */
+        const __m128i percent = _mm_set1_epi8('%');
+        const __m128i plus = _mm_set1_epi8(plusIsSpace ? '+' : '%');
+        while (i + 16 <= in.size())
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in.data() + i));
+            int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, percent), _mm_cmpeq_epi8(chunk, plus)));
+            if (mask != 0)
+            {
+                size_t run = static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+                std::memmove(out + o, in.data() + i, run);
+                i += run;
+                o += run;
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), chunk);
+            i += 16;
+            o += 16;
+        }
+        if (i >= in.size())
+        {
+            break;
+        }
+#endif
+        char c = in[i];
+        if (c == '%' && i + 2 < in.size() && hexValue(in[i + 1]) >= 0 && hexValue(in[i + 2]) >= 0)
+        {
+            out[o++] = static_cast<char>(hexValue(in[i + 1]) * 16 + hexValue(in[i + 2]));
+            i += 3;
+        }
+        else
+        {
+            out[o++] = c == '+' && plusIsSpace ? ' ' : c;
+            ++i;
+        }
+    }
+    return o;
+}
+
+void
+Params::parse() const
+{
+    if (parsed)
+    {
+        return;
+    }
+    parsed = true;
+
+    /* Decoding never grows the text, so views into `decoded` stay valid */
+    decoded.resize(source.size());
+    char separator = syntax == Syntax::Query ? '&' : ';';
+    bool plusIsSpace = syntax == Syntax::Query;
+    size_t used = 0;
+
+    std::string_view rest = source;
+    while (!rest.empty())
+    {
+        size_t pairEnd = rest.find(separator);
+        std::string_view pair = rest.substr(0, pairEnd);
+        rest = pairEnd == std::string_view::npos ? std::string_view() : rest.substr(pairEnd + 1);
+        if (syntax == Syntax::Cookie)
+        {
+            pair = trimSpaces(pair);
+        }
+        if (pair.empty())
+        {
+            continue;
+        }
+
+        size_t equals = pair.find('=');
+        std::string_view key = pair.substr(0, equals);
+        std::string_view value = equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+        if (syntax == Syntax::Cookie && value.size() >= 2 && value.front() == '"' && value.back() == '"')
+        {
+            value = value.substr(1, value.size() - 2);
+        }
+
+        char* out = decoded.data() + used;
+        size_t keyLength = decode(key, out, plusIsSpace);
+        size_t valueLength = decode(value, out + keyLength, plusIsSpace);
+        used += keyLength + valueLength;
+        pairs.emplace_back(std::string_view(out, keyLength), std::string_view(out + keyLength, valueLength));
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * Key/value pairs from a query string, Cookie header or form-encoded body.
+ * Only the source text is recorded up front; it is split and percent-decoded
+ * the first time anything is looked up, and the decoded pairs are kept for
+ * later lookups. Repeated keys keep every value in order.
+ *
+ * The source must outlive the Params; decoded text lives in one buffer from
+ * the request's memory resource.
+ */
+class Params
+{
+public:
+    enum class Syntax
+    {
+        Query,      /* a=1&b=2, '+' is a space */
+        Cookie      /* a=1; b=2 */
+    };
+
+    using Pair = std::pair<std::string_view, std::string_view>;
+    using const_iterator = std::pmr::vector<Pair>::const_iterator;
+
+    explicit Params(Syntax syntax, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void assign(std::string_view text);
+
+    /* First value for `key`, empty if absent */
+    std::string_view get(std::string_view key) const;
+    std::pmr::vector<std::string_view> getAll(std::string_view key) const;
+    bool has(std::string_view key) const;
+
+    size_t size() const { parse(); return pairs.size(); }
+    bool empty() const { return size() == 0; }
+    const_iterator begin() const { parse(); return pairs.begin(); }
+    const_iterator end() const { parse(); return pairs.end(); }
+
+    /* Percent-decodes `in` into `out` (at least in.size() bytes); returns the decoded length */
+    static size_t decode(std::string_view in, char* out, bool plusIsSpace);
+
+private:
+    Syntax syntax;
+    std::string_view source;
+    mutable bool parsed;
+    mutable std::pmr::string decoded;
+    mutable std::pmr::vector<Pair> pairs;
+
+    void parse() const;
+};
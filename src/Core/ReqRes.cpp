@@ -1,6 +1,7 @@
 #include "ReqRes.h"
 
 #include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -18,7 +19,7 @@ operator<<(std::ostream& os, const Request& request)
     os << "Headers:\n";
     for (const auto& header : request.headers)
     {
-        os << "  " << header.first << ": " << header.second << "\n";
+        os << "  " << header.name << ": " << header.value << "\n";
     }
 
     os << "Query Parameters:\n";
@@ -33,74 +34,176 @@ operator<<(std::ostream& os, const Request& request)
 
 #pragma region Request
 
-Request::Request(const std::string& httpRequest)
+Request::Request(std::string_view httpRequest, std::pmr::memory_resource* resource)
+    : method(resource), url(resource), protocol(resource), version(resource), host(resource), port(80),
+      path(resource), body(resource), headers(resource), query(Params::Syntax::Query, resource),
+      cookies(Params::Syntax::Cookie, resource), stream(nullptr), bodyRead(false), formAssigned(false),
+      formParams(Params::Syntax::Query, resource), jsonParsed(false), jsonRoot(nullptr)
 {
     parseRequest(httpRequest);
 }
 
-std::string
-Request::getHeader(const std::string& key) const
+Request::Request(const RequestHead& head, std::pmr::memory_resource* resource)
+    : method(resource), url(resource), protocol(resource), version(resource), host(resource), port(80),
+      path(resource), body(resource), headers(resource), query(Params::Syntax::Query, resource),
+      cookies(Params::Syntax::Cookie, resource), stream(nullptr), bodyRead(false), formAssigned(false),
+      formParams(Params::Syntax::Query, resource), jsonParsed(false), jsonRoot(nullptr)
 {
-    auto it = headers.find(key);
-    return it != headers.end() ? it->second : "";
+    setRequestLine(head.method, head.target, head.version);
+    for (const RequestHead::Field& field : head.fields)
+    {
+        headers.add(field.name, field.value);
+    }
+    cookies.assign(headers.get(HeaderId::Cookie));
 }
 
-std::string
-Request::queryParam(const std::string& key) const
+std::string_view
+Request::getHeader(std::string_view key) const
 {
-    auto it = query.find(key);
-    return it != query.end() ? it->second : "";
+    return headers.get(key);
 }
 
-void
-Request::parseRequest(const std::string& httpRequest)
+const Params&
+Request::form() const
 {
-    std::istringstream requestStream(httpRequest);
-    std::string requestLine;
+    if (!formAssigned)
+    {
+        formAssigned = true;
+        std::string_view contentType = getHeader(HeaderId::ContentType);
+        if (contentType.substr(0, contentType.find(';')) == "application/x-www-form-urlencoded")
+        {
+            formParams.assign(body);
+        }
+    }
+    return formParams;
+}
 
-    std::getline(requestStream, requestLine);
-    std::istringstream requestLineStream(requestLine);
-    requestLineStream >> method >> url;
+const JsonValue*
+Request::json() const
+{
+    if (!jsonParsed)
+    {
+        jsonParsed = true;
+        jsonRoot = parseJson(body, body.get_allocator().resource());
+    }
+    return jsonRoot;
+}
 
-    extractUrlComponents(url);
+void
+Request::onData(BodyStream::DataCallback callback) const
+{
+    if (stream)
+    {
+        stream->dataCallback = std::move(callback);
+    }
+    else if (!body.empty())
+    {
+        callback(body);
+    }
+}
 
-    size_t queryPos = url.find('?');
-    if (queryPos != std::string::npos)
+void
+Request::onEnd(BodyStream::EndCallback callback) const
+{
+    if (stream)
     {
-        path = url.substr(0, queryPos);
-        std::string queryString = url.substr(queryPos + 1);
-        parseQueryParams(queryString);
-    } 
+        stream->endCallback = std::move(callback);
+    }
     else
     {
-        path = url;
+        callback();
     }
+}
 
-    std::string headerLine;
-    while (std::getline(requestStream, headerLine) && !headerLine.empty()) 
+BodyStream::ReadAwaiter
+Request::read() const
+{
+    std::string_view immediate = bodyRead ? std::string_view() : std::string_view(body);
+    bodyRead = true;
+    return BodyStream::ReadAwaiter(stream, immediate);
+}
+
+void
+Request::parseRequest(std::string_view httpRequest)
+{
+    size_t lineEnd = httpRequest.find('\n');
+    std::string_view requestLine = trim(httpRequest.substr(0, lineEnd));
+
+    size_t methodEnd = requestLine.find(' ');
+    std::string_view target;
+    std::string_view requestVersion;
+    if (methodEnd != std::string_view::npos)
     {
+        target = trim(requestLine.substr(methodEnd + 1));
+        size_t targetEnd = target.find(' ');
+        if (targetEnd != std::string_view::npos)
+        {
+            requestVersion = trim(target.substr(targetEnd + 1));
+        }
+        target = target.substr(0, targetEnd);
+    }
+    setRequestLine(requestLine.substr(0, methodEnd), target, requestVersion);
+
+    size_t lineStart = lineEnd == std::string_view::npos ? httpRequest.size() : lineEnd + 1;
+    while (lineStart < httpRequest.size())
+    {
+        lineEnd = httpRequest.find('\n', lineStart);
+        std::string_view headerLine = httpRequest.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd == std::string_view::npos ? httpRequest.size() : lineEnd + 1;
+
+        if (!headerLine.empty() && headerLine.back() == '\r')
+        {
+            headerLine.remove_suffix(1);
+        }
+        if (headerLine.empty())
+        {
+            break;
+        }
+
         size_t separator = headerLine.find(':');
-        if (separator != std::string::npos)
+        if (separator != std::string_view::npos)
         {
-            std::string key = trim(headerLine.substr(0, separator));
-            std::string value = trim(headerLine.substr(separator + 1));
-            headers[key] = value;
+            std::string_view key = trim(headerLine.substr(0, separator));
+            std::string_view value = trim(headerLine.substr(separator + 1));
+            headers.add(key, value);
         }
     }
+    cookies.assign(headers.get(HeaderId::Cookie));
 
-    std::string remaining;
-    while (std::getline(requestStream, remaining)) 
+    body = httpRequest.substr(lineStart);
+}
+
+void
+Request::setRequestLine(std::string_view requestMethod, std::string_view target, std::string_view requestVersion)
+{
+    method = requestMethod;
+    url = target;
+    version = requestVersion;
+    extractUrlComponents(url);
+
+    /* Absolute-form targets carry the origin in front of the path */
+    std::string_view pathAndQuery = url;
+    size_t schemeEnd = pathAndQuery.find("://");
+    if (schemeEnd != std::string_view::npos)
     {
-        body += remaining + "\n";
+        size_t pathStart = pathAndQuery.find_first_of("/?", schemeEnd + 3);
+        pathAndQuery = pathStart == std::string_view::npos ? std::string_view("/") : pathAndQuery.substr(pathStart);
     }
-    if (!body.empty()) 
+
+    size_t queryPos = pathAndQuery.find('?');
+    if (queryPos != std::string_view::npos)
     {
-        body.pop_back();
+        path = pathAndQuery.substr(0, queryPos);
+        query.assign(pathAndQuery.substr(queryPos + 1));
+    }
+    else
+    {
+        path = pathAndQuery;
     }
 }
 
 void
-Request::extractUrlComponents(const std::string& url) 
+Request::extractUrlComponents(std::string_view url) 
 {
     if (url.find("https://") == 0)
     {
@@ -121,7 +224,8 @@ Request::extractUrlComponents(const std::string& url)
     if (portStart != std::string::npos && (pathStart == std::string::npos || portStart < pathStart)) 
     {
         host = url.substr(hostStart, portStart - hostStart);
-        port = std::stoi(url.substr(portStart + 1, pathStart - portStart - 1));
+        std::string_view portStr = url.substr(portStart + 1, pathStart - portStart - 1);
+        std::from_chars(portStr.data(), portStr.data() + portStr.size(), port);
     } 
     else 
     {
@@ -136,36 +240,20 @@ Request::extractUrlComponents(const std::string& url)
     }
 }
 
-void
-Request::parseQueryParams(const std::string& queryString) 
-{
-    std::istringstream queryStream(queryString);
-    std::string pair;
-    while (std::getline(queryStream, pair, '&')) 
-    {
-        size_t separator = pair.find('=');
-        if (separator != std::string::npos) 
-        {
-            std::string key = trim(pair.substr(0, separator));
-            std::string value = trim(pair.substr(separator + 1));
-            query[key] = value;
-        }
-    }
-}
-
-std::string
-Request::trim(const std::string& str) 
+std::string_view
+Request::trim(std::string_view str) 
 {
-    size_t first = str.find_first_not_of(' ');
-    size_t last = str.find_last_not_of(' ');
-    return (first == std::string::npos) ? "" : str.substr(first, (last - first + 1));
+    size_t first = str.find_first_not_of(" \t\r");
+    size_t last = str.find_last_not_of(" \t\r");
+    return (first == std::string::npos) ? std::string_view() : str.substr(first, (last - first + 1));
 }
 
 #pragma endregion
 
 #pragma region Response
 
-Response::Response() : statusCode(200) 
+Response::Response(std::pmr::memory_resource* resource)
+    : statusCode(200), body(resource), headers(resource), eventStream(nullptr)
 {
 }
 
@@ -177,50 +265,193 @@ Response::status(int code)
 }
 
 Response& 
-Response::setHeader(const std::string& key, const std::string& value) 
+Response::setHeader(std::string_view key, std::string_view value) 
 {
-    headers[key] = value;
+    if (!equalsIgnoreCase(key, "Content-Length"))
+    {
+        headers.set(key, value);
+    }
     return *this;
 }
 
 Response& 
-Response::send(const std::string& responseBody) 
+Response::send(std::string_view responseBody) 
+{
+    body.assign(responseBody);
+    external = {};
+    headers.set("Content-Type", "text/plain");
+    return *this;
+}
+
+Response&
+Response::send(const std::string& responseBody)
 {
     body = responseBody;
-    setHeader("Content-Length", std::to_string(body.size()));
-    setHeader("Content-Type", "text/plain");
+    external = {};
+    headers.set("Content-Type", "text/plain");
+    return *this;
+}
+
+Response&
+Response::send(std::string&& responseBody)
+{
+    body.clear();
+    movedBody = std::move(responseBody);
+    external = movedBody;
+    headers.set("Content-Type", "text/plain");
+    return *this;
+}
+
+Response&
+Response::send(std::shared_ptr<const Buffer> responseBody, size_t offset)
+{
+    body.clear();
+    sharedBody = std::move(responseBody);
+    external = sharedBody->view().substr(offset);
+    headers.set("Content-Type", "text/plain");
+    return *this;
+}
+
+Response&
+Response::sendStatic(std::string_view responseBody)
+{
+    body.clear();
+    external = responseBody;
+    headers.set("Content-Type", "text/plain");
     return *this;
 }
 
 Response& 
-Response::json(const std::string& jsonBody) 
+Response::json(std::string_view jsonBody) 
+{
+    send(jsonBody);
+    setHeader("Content-Type", "application/json");
+    return *this;
+}
+
+Response&
+Response::json(const std::string& jsonBody)
+{
+    send(jsonBody);
+    setHeader("Content-Type", "application/json");
+    return *this;
+}
+
+Response&
+Response::json(std::string&& jsonBody)
+{
+    send(std::move(jsonBody));
+    setHeader("Content-Type", "application/json");
+    return *this;
+}
+
+Response&
+Response::json(std::shared_ptr<const Buffer> jsonBody, size_t offset)
 {
-    body = jsonBody;
-    setHeader("Content-Length", std::to_string(body.size()));
+    send(std::move(jsonBody), offset);
     setHeader("Content-Type", "application/json");
     return *this;
 }
 
+Response&
+Response::jsonStatic(std::string_view jsonBody)
+{
+    sendStatic(jsonBody);
+    setHeader("Content-Type", "application/json");
+    return *this;
+}
+
+JsonWriter
+Response::jsonWriter()
+{
+    body.clear();
+    external = {};
+    setHeader("Content-Type", "application/json");
+    return JsonWriter(body);
+}
+
 Response& 
 Response::sendFile(const std::string& filePath) 
 {
-    body = readFile(filePath);
+    send(readFile(filePath));
     setHeader("Content-Type", "text/html");
-    setHeader("Content-Length", std::to_string(body.size()));
     return *this;
 }
 
-std::string 
-Response::toHttpResponse() const 
+Response&
+Response::render(const Template& page, Template::Values values)
 {
-    std::ostringstream response;
-    response << "HTTP/1.1 " << statusCode << " " << getStatusMessage() << "\r\n";
-    for (const auto& header : headers) 
+    body.clear();
+    external = {};
+    page.render(values, body);
+    setHeader("Content-Type", "text/html; charset=utf-8");
+    return *this;
+}
+
+Response&
+Response::defer(std::function<void()> work)
+{
+    deferred = std::move(work);
+    return *this;
+}
+
+Response&
+Response::subscribe(Channel& channel)
+{
+    /* No Content-Length: the stream lasts as long as the connection */
+    eventStream = &channel;
+    body.clear();
+    external = {};
+    setHeader("Content-Type", "text/event-stream");
+    setHeader("Cache-Control", "no-cache");
+    return *this;
+}
+
+void
+Response::serialize(std::pmr::string& out, const HeaderBlock* defaults) const
+{
+    serializeHead(out, defaults);
+    out.append(content());
+}
+
+void
+Response::serializeHead(std::pmr::string& out, const HeaderBlock* defaults) const
+{
+    char number[24];
+    auto result = std::to_chars(number, number + sizeof(number), statusCode);
+
+    out.append("HTTP/1.1 ");
+    out.append(number, result.ptr - number);
+    out.push_back(' ');
+    out.append(getStatusMessage());
+    out.append("\r\n");
+    if (defaults)
+    {
+        defaults->appendTo(out, headers);
+    }
+    for (ResponseHeaders::Field header : headers)
+    {
+        out.append(header.name);
+        out.append(": ");
+        out.append(header.value);
+        out.append("\r\n");
+    }
+    if (!eventStream)
     {
-        response << header.first << ": " << header.second << "\r\n";
+        result = std::to_chars(number, number + sizeof(number), content().size());
+        out.append("Content-Length: ");
+        out.append(number, result.ptr - number);
+        out.append("\r\n");
     }
-    response << "\r\n" << body;
-    return response.str();
+    out.append("\r\n");
+}
+
+std::string 
+Response::toHttpResponse() const 
+{
+    std::pmr::string response;
+    serialize(response);
+    return std::string(response);
 }
 
 std::string 
@@ -237,15 +468,55 @@ Response::readFile(const std::string& filePath)
     return buffer.str();
 }
 
-std::string 
+const char*
 Response::getStatusMessage() const 
 {
-    switch (statusCode) 
+    return reason(statusCode);
+}
+
+const char*
+Response::reason(int code)
+{
+    switch (code)
     {
         case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 303: return "See Other";
+        case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
         case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 402: return "Payment Required";
+        case 403: return "Forbidden";
         case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 406: return "Not Acceptable";
+        case 408: return "Request Timeout";
+        case 409: return "Conflict";
+        case 410: return "Gone";
+        case 411: return "Length Required";
+        case 412: return "Precondition Failed";
+        case 413: return "Payload Too Large";
+        case 414: return "URI Too Long";
+        case 415: return "Unsupported Media Type";
+        case 417: return "Expectation Failed";
+        case 422: return "Unprocessable Content";
+        case 426: return "Upgrade Required";
+        case 428: return "Precondition Required";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 451: return "Unavailable For Legal Reasons";
         case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        case 505: return "HTTP Version Not Supported";
         default: return "Unknown Status";
     }
 }
@@ -1,53 +1,149 @@
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <memory_resource>
 #include <unordered_map>
 #include <vector>
+#include "BodyStream.h"
+#include "Buffer.h"
+#include "HeadParser.h"
+#include "Headers.h"
+#include "Json.h"
+#include "JsonWriter.h"
+#include "Params.h"
+#include "Template.h"
 
+class Channel;
 
+/* Lets string-keyed maps be searched with a string_view without building a key */
+struct StringHash
+{
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+};
+
+/*
+ * Request and Response draw all their memory from the resource they are
+ * built with, normally the worker's per-request Arena.
+ */
 class Request
 {
 public:
-    Request(const std::string& httpRequest);
-    std::string getHeader(const std::string& key) const;
-    std::string queryParam(const std::string& key) const;
+    explicit Request(std::string_view httpRequest, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    /* From a head already validated by HeadParser; the body is filled in separately */
+    explicit Request(const RequestHead& head, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    /* Case-insensitive; the HeaderId overload skips hashing the name */
+    std::string_view getHeader(std::string_view key) const;
+    std::string_view getHeader(HeaderId id) const { return headers.get(id); }
+    std::string_view queryParam(std::string_view key) const { return query.get(key); }
+    std::string_view cookie(std::string_view name) const { return cookies.get(name); }
+    /* Fields of an application/x-www-form-urlencoded body, parsed on first use; call once the body is complete */
+    const Params& form() const;
+    /* Body parsed as JSON into the request's memory on first use, nullptr if it isn't valid JSON; call once the body is complete */
+    const JsonValue* json() const;
+
+    /*
+     * Body access that works whether or not the route streams its body:
+     * without a stream the whole body is delivered at once.
+     */
+    void onData(BodyStream::DataCallback callback) const;
+    void onEnd(BodyStream::EndCallback callback) const;
+    BodyStream::ReadAwaiter read() const;
+
     friend std::ostream& operator<<(std::ostream& os, const Request& request);
 
 public:
-    std::string method;
-    std::string url;
-    std::string protocol;
-    std::string host;
+    std::pmr::string method;
+    std::pmr::string url;
+    std::pmr::string protocol;
+    std::pmr::string version;
+    std::pmr::string host;
     int port;
-    std::string path;
-    std::string body;
-    std::unordered_map<std::string, std::string> headers;
-    std::unordered_map<std::string, std::string> query;
+    std::pmr::string path;
+    std::pmr::string body;
+    Headers headers;
+    Params query;
+    Params cookies;
+    BodyStream* stream;
 
 private:
-    void parseRequest(const std::string& httpRequest);
-    void extractUrlComponents(const std::string& url);
-    void parseQueryParams(const std::string& queryString);
-    std::string trim(const std::string& str);
+    mutable bool bodyRead;
+    mutable bool formAssigned;
+    mutable Params formParams;
+    mutable bool jsonParsed;
+    mutable const JsonValue* jsonRoot;
+
+    void parseRequest(std::string_view httpRequest);
+    void setRequestLine(std::string_view requestMethod, std::string_view target, std::string_view requestVersion);
+    void extractUrlComponents(std::string_view url);
+    static std::string_view trim(std::string_view str);
 };
 
 class Response
 {
 public:
-    Response();
+    explicit Response(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
     Response& status(int code);
-    Response& setHeader(const std::string& key, const std::string& value);
+    /* Content-Length is ignored here: it always comes from the body */
+    Response& setHeader(std::string_view key, std::string_view value);
+    /*
+     * Bodies are copied, or moved when they are std::string temporaries, so
+     * a stack buffer or a string changed right after is safe to send. Shared
+     * buffers are held by reference count; `offset` skips the front of the
+     * buffer.
+     */
+    Response& send(std::string_view responseBody);
+    Response& send(const char* responseBody) { return send(std::string_view(responseBody)); }
     Response& send(const std::string& responseBody);
+    Response& send(std::string&& responseBody);
+    Response& send(std::shared_ptr<const Buffer> responseBody, size_t offset = 0);
+    /*
+     * Keeps a reference to `responseBody` and never copies it: the bytes have
+     * to stay valid until the response is written, as string literals and
+     * other static storage do.
+     */
+    Response& sendStatic(std::string_view responseBody);
+    /* As send() and sendStatic(), with Content-Type: application/json */
+    Response& json(std::string_view jsonBody);
+    Response& json(const char* jsonBody) { return json(std::string_view(jsonBody)); }
     Response& json(const std::string& jsonBody);
+    Response& json(std::string&& jsonBody);
+    Response& json(std::shared_ptr<const Buffer> jsonBody, size_t offset = 0);
+    Response& jsonStatic(std::string_view jsonBody);
+    /* Starts an application/json body that the returned writer encodes into in place */
+    JsonWriter jsonWriter();
     Response& sendFile(const std::string& filePath);
+    /* Renders `page` into the body as text/html */
+    Response& render(const Template& page, Template::Values values);
+    /* Finishes the response on the compute pool; `work` fills in this response */
+    Response& defer(std::function<void()> work);
+    /* Turns the response into a text/event-stream that receives what `channel` publishes (HTTP/1.1 only) */
+    Response& subscribe(Channel& channel);
+    /* Status line, `defaults` unless overridden, headers, Content-Length and body */
+    void serialize(std::pmr::string& out, const HeaderBlock* defaults = nullptr) const;
+    /* serialize() without the body */
+    void serializeHead(std::pmr::string& out, const HeaderBlock* defaults = nullptr) const;
+    /* The body, wherever it is kept */
+    std::string_view content() const { return external.data() ? external : std::string_view(body); }
     std::string toHttpResponse() const;
+    /* Reason phrase of a status code */
+    static const char* reason(int code);
 
 public:
     int statusCode;
-    std::string body;
-    std::unordered_map<std::string, std::string> headers;
+    std::pmr::string body;
+    std::string_view external;  /* Set by sendStatic() and the overloads that don't copy; the body is these bytes, not `body` */
+    ResponseHeaders headers;
+    std::function<void()> deferred;
+    Channel* eventStream;
 
 private:
+    std::string movedBody;
+    std::shared_ptr<const Buffer> sharedBody;
+
     std::string readFile(const std::string& filePath);
-    std::string getStatusMessage() const;
-};
\ No newline at end of file
+    const char* getStatusMessage() const;
+};
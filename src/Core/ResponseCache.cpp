@@ -0,0 +1,125 @@
+#include "ResponseCache.h"
+
+#include <algorithm>
+#include <charconv>
+
+SharedResponse
+SharedResponse::make(std::string wire)
+{
+    size_t headEnd = wire.find("\r\n\r\n");
+    return SharedResponse{Buffer::make(std::move(wire)), headEnd + 2};
+}
+
+void
+SharedResponse::restore(Response& res) const
+{
+    /* The body is shared with the entry rather than copied; send()'s Content-Type gives way to the stored one */
+    res.send(wire, headEnd + 2);
+    res.headers.erase("Content-Type");
+
+    std::string_view head = wire->view().substr(0, headEnd);
+
+    /* "HTTP/1.1 200 OK\r\n" */
+    size_t lineEnd = head.find("\r\n");
+    int status = 200;
+    std::from_chars(head.data() + 9, head.data() + lineEnd, status);
+    res.status(status);
+
+    head.remove_prefix(lineEnd + 2);
+    while (!head.empty())
+    {
+        lineEnd = head.find("\r\n");
+        std::string_view line = head.substr(0, lineEnd);
+        head.remove_prefix(lineEnd + 2);
+
+        size_t colon = line.find(": ");
+        res.setHeader(line.substr(0, colon), line.substr(colon + 2));
+    }
+}
+
+ResponseCache::ResponseCache(const CacheOptions& options)
+    : options(options), shardCapacity(std::max<size_t>(1, options.maxEntries / ShardCount))
+{
+}
+
+bool
+ResponseCache::lookup(std::string_view key, Hit& hit)
+{
+    Clock::time_point now = Clock::now();
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end())
+    {
+        return false;
+    }
+
+    Entry& entry = it->second;
+    Clock::duration age = now - entry.storedAt;
+    if (age >= options.ttl + options.staleWhileRevalidate)
+    {
+        /* Too old to serve even while refreshing; the miss refreshes it */
+        return false;
+    }
+    hit.response = entry.response;
+    hit.refresh = age >= options.ttl && !entry.refreshing;
+    if (hit.refresh)
+    {
+        entry.refreshing = true;
+    }
+    return true;
+}
+
+void
+ResponseCache::store(std::string_view key, const SharedResponse& response)
+{
+    Entry entry{response, Clock::now(), false};
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end())
+    {
+        it->second = std::move(entry);
+        return;
+    }
+    if (shard.entries.size() >= shardCapacity)
+    {
+        evict(shard, entry.storedAt);
+    }
+    shard.entries.emplace(key, std::move(entry));
+}
+
+void
+ResponseCache::abandonRefresh(std::string_view key)
+{
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end())
+    {
+        it->second.refreshing = false;
+    }
+}
+
+void
+ResponseCache::evict(Shard& shard, Clock::time_point now)
+{
+    /* Expired entries go first; if none are, any one makes room */
+    for (auto it = shard.entries.begin(); it != shard.entries.end();)
+    {
+        if (now - it->second.storedAt >= options.ttl + options.staleWhileRevalidate)
+        {
+            it = shard.entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (shard.entries.size() >= shardCapacity)
+    {
+        shard.entries.erase(shard.entries.begin());
+    }
+}
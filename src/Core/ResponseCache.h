@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Buffer.h"
+#include "ReqRes.h"
+
+/* Response caching for a GET route; a zero ttl turns it off */
+struct CacheOptions
+{
+    std::chrono::milliseconds ttl{0};
+    /* Request headers whose values select different cached responses */
+    std::vector<std::string> varyHeaders{};
+    /* How long past ttl an entry is still served while one request refreshes it */
+    std::chrono::milliseconds staleWhileRevalidate = std::chrono::minutes(1);
+    size_t maxEntries = 1024;
+};
+
+/* An HTTP/1.1 response serialized once for many clients, without its Connection header */
+struct SharedResponse
+{
+    std::shared_ptr<const Buffer> wire;
+    size_t headEnd = 0;     /* Offset of the blank line ending the head */
+
+    static SharedResponse make(std::string wire);
+    /* Status, headers and body, for protocols that frame the response themselves */
+    void restore(Response& res) const;
+};
+
+/*
+ * Serialized HTTP/1.1 responses of one route, keyed by target and vary
+ * header values, in a map split into independently locked shards. Entries
+ * hold the bytes without the Connection header, which depends on the
+ * request; lookups hand out a reference, not a copy.
+ *
+ * Once an entry is past its ttl the next lookup is told to refresh it, and
+ * until that refresh is stored everyone else keeps getting the stale bytes.
+ */
+class ResponseCache
+{
+public:
+    struct Hit
+    {
+        SharedResponse response;
+        bool refresh = false;   /* Stale, and this caller is the one to refresh it */
+    };
+
+    explicit ResponseCache(const CacheOptions& options);
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    bool lookup(std::string_view key, Hit& hit);
+    void store(std::string_view key, const SharedResponse& response);
+    /* Ends a refresh that didn't store a new entry, so a later lookup may try again */
+    void abandonRefresh(std::string_view key);
+
+    const CacheOptions options;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t ShardCount = 16;
+
+    struct Entry
+    {
+        SharedResponse response;
+        Clock::time_point storedAt;
+        bool refreshing;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry, StringHash, std::equal_to<>> entries;
+    };
+
+    std::array<Shard, ShardCount> shards;
+    size_t shardCapacity;
+
+    Shard& shardFor(std::string_view key) { return shards[StringHash{}(key) % ShardCount]; }
+    void evict(Shard& shard, Clock::time_point now);
+};
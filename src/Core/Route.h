@@ -0,0 +1,39 @@
+#pragma once
+
+#include <functional>
+#include "ThreadPool.h"
+#include "ReqRes.h"
+#include "ResponseCache.h"
+#include "SingleFlight.h"
+#include "Task.h"
+#include "WebSocket.h"
+
+/* Per-route registration options */
+struct RouteOptions
+{
+    Priority priority = Priority::Normal;
+    /* Run the handler as soon as headers arrive and hand it the body through req.onData / req.read */
+    bool streamBody = false;
+    /* Serve GETs from a cache of serialized responses */
+    CacheOptions cache{};
+    /* Concurrent GETs with the same target and cache.varyHeaders wait for one handler run and share its response */
+    bool singleFlight = false;
+};
+
+/* A registered endpoint: exactly one of handler / asyncHandler / webSocketHandler is set */
+struct Route
+{
+    using Handler = std::function<void(const Request&, Response&)>;
+    using AsyncHandler = std::function<Task<>(const Request&, Response&)>;
+    using WebSocketHandler = std::function<void(const std::shared_ptr<WebSocket>& socket, const Request&)>;
+
+    Handler handler;
+    AsyncHandler asyncHandler;
+    WebSocketHandler webSocketHandler;
+    RouteOptions options;
+    std::shared_ptr<ResponseCache> cache;   /* Set when options.cache has a ttl */
+    std::shared_ptr<SingleFlight> flights;  /* Set when options.singleFlight is */
+    /* Set by App::getStatic: the whole response, with a placeholder Date value at dateOffset */
+    SharedResponse prebuilt;
+    size_t dateOffset = 0;
+};
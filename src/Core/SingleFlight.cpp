@@ -0,0 +1,29 @@
+#include "SingleFlight.h"
+
+bool
+SingleFlight::join(std::string_view key, Exchange* exchange)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = flights.find(key);
+    if (it == flights.end())
+    {
+        flights.emplace(key, std::vector<Exchange*>());
+        return true;
+    }
+    it->second.push_back(exchange);
+    return false;
+}
+
+std::vector<Exchange*>
+SingleFlight::land(std::string_view key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = flights.find(key);
+    if (it == flights.end())
+    {
+        return {};
+    }
+    std::vector<Exchange*> waiters = std::move(it->second);
+    flights.erase(it);
+    return waiters;
+}
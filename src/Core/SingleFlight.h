@@ -0,0 +1,29 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ReqRes.h"
+
+struct Exchange;
+
+/*
+ * Identical requests of one route that are being handled right now, keyed
+ * like the route's cache. The first request of a key leads: it runs the
+ * handler, and the ones arriving meanwhile wait on it instead of running
+ * the handler themselves.
+ */
+class SingleFlight
+{
+public:
+    /* True if `exchange` leads a new flight, false if it now waits on the running one */
+    bool join(std::string_view key, Exchange* exchange);
+    /* Ends the flight of `key`; returns the requests that waited on it */
+    std::vector<Exchange*> land(std::string_view key);
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<Exchange*>, StringHash, std::equal_to<>> flights;
+};
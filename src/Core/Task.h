@@ -0,0 +1,170 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+/*
+ * Lazily started coroutine. A Task is either co_awaited by another Task, which
+ * resumes when it finishes, or detached with start(), which owns the frame
+ * until completion and then reports to the given callback.
+ */
+template<class T = void>
+class Task;
+
+namespace detail
+{
+    struct TaskPromiseBase
+    {
+        std::coroutine_handle<> continuation;
+        std::function<void(std::exception_ptr)> onComplete;
+        std::exception_ptr exception;
+        bool detached = false;
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template<class Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                TaskPromiseBase& promise = handle.promise();
+                if (promise.continuation)
+                {
+                    return promise.continuation;
+                }
+
+                if (promise.detached)
+                {
+                    auto onComplete = std::move(promise.onComplete);
+                    auto exception = promise.exception;
+                    handle.destroy();
+                    if (onComplete)
+                    {
+                        onComplete(exception);
+                    }
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+    };
+
+    template<class T>
+    struct TaskPromise : TaskPromiseBase
+    {
+        std::optional<T> value;
+
+        template<class U>
+        void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+
+        T result()
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+            return std::move(*value);
+        }
+    };
+
+    template<>
+    struct TaskPromise<void> : TaskPromiseBase
+    {
+        void return_void() noexcept {}
+
+        void result()
+        {
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+}
+
+template<class T>
+class Task
+{
+public:
+    struct promise_type : detail::TaskPromise<T>
+    {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() { reset(); }
+
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() { return handle.promise().result(); }
+
+    /* Runs the coroutine without an awaiter; the frame frees itself when done */
+    void start(std::function<void(std::exception_ptr)> onComplete = {})
+    {
+        auto started = std::exchange(handle, {});
+        started.promise().detached = true;
+        started.promise().onComplete = std::move(onComplete);
+        started.resume();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    void reset()
+    {
+        if (handle)
+        {
+            handle.destroy();
+            handle = {};
+        }
+    }
+};
+
+/* Suspends the awaiting coroutine and hands `arm` the callback that resumes it */
+class EventAwaiter
+{
+public:
+    using Arm = std::function<void(std::function<void()>)>;
+
+    explicit EventAwaiter(Arm arm) : arm(std::move(arm)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        /* The coroutine may resume (and free this awaiter) before arm returns */
+        Arm armNow = std::move(arm);
+        armNow([handle] { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    Arm arm;
+};
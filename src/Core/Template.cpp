@@ -0,0 +1,202 @@
+#include "Template.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include "ByteScan.h"
+
+namespace
+{
+    /* Characters that become entities */
+    constexpr ByteSet HTML_SPECIAL("&<>\"'");
+
+    std::string_view entity(char c)
+    {
+        switch (c)
+        {
+            case '&': return "&amp;";
+            case '<': return "&lt;";
+            case '>': return "&gt;";
+            case '"': return "&quot;";
+            default: return "&#39;";
+        }
+    }
+
+    std::string_view trim(std::string_view str)
+    {
+        size_t first = str.find_first_not_of(" \t\r\n");
+        size_t last = str.find_last_not_of(" \t\r\n");
+        return first == std::string_view::npos ? std::string_view() : str.substr(first, last - first + 1);
+    }
+
+    bool readModified(const std::string& path, timespec& modified)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+        {
+            return false;
+        }
+        modified = info.st_mtim;
+        return true;
+    }
+}
+
+Template::Template(std::string path)
+    : path(std::move(path)), checkedAt(time(nullptr))
+{
+    std::shared_ptr<const Program> compiled = compile(this->path);
+    if (!compiled)
+    {
+        std::cerr << "Could not open template: " << this->path << "\n";
+        compiled = std::make_shared<const Program>();
+    }
+    program.store(std::move(compiled));
+}
+
+void
+Template::render(Values values, std::pmr::string& out) const
+{
+    std::shared_ptr<const Program> compiled = current();
+
+    /* Each slot's value is found once, not at every place it is used */
+    std::pmr::vector<std::string_view> bound(compiled->slots.size(), out.get_allocator().resource());
+    size_t size = compiled->literalSize;
+    for (size_t i = 0; i < bound.size(); ++i)
+    {
+        for (const auto& [name, value] : values)
+        {
+            if (name == compiled->slots[i])
+            {
+                bound[i] = value;
+                size += value.size();
+                break;
+            }
+        }
+    }
+
+    out.reserve(out.size() + size);
+    for (const Instruction& instruction : compiled->code)
+    {
+        switch (instruction.kind)
+        {
+            case Instruction::Kind::Literal:
+                out.append(instruction.text);
+                break;
+            case Instruction::Kind::Escaped:
+                escapeHtml(bound[instruction.slot], out);
+                break;
+            case Instruction::Kind::Raw:
+                out.append(bound[instruction.slot]);
+                break;
+        }
+    }
+}
+
+void
+Template::escapeHtml(std::string_view text, std::pmr::string& out)
+{
+    while (true)
+    {
+        size_t clean = cleanPrefix(text.data(), text.size(), HTML_SPECIAL);
+        out.append(text.data(), clean);
+        if (clean == text.size())
+        {
+            break;
+        }
+        out.append(entity(text[clean]));
+        text.remove_prefix(clean + 1);
+    }
+}
+
+std::shared_ptr<const Template::Program>
+Template::current() const
+{
+    time_t now = time(nullptr);
+    time_t checked = checkedAt.load(std::memory_order_relaxed);
+    if (now == checked || !checkedAt.compare_exchange_strong(checked, now, std::memory_order_relaxed))
+    {
+        return program.load();
+    }
+
+    /* One thread a second gets here; the others keep rendering what there is */
+    std::unique_lock<std::mutex> lock(reloading, std::try_to_lock);
+    std::shared_ptr<const Program> compiled = program.load();
+    timespec modified;
+    if (lock.owns_lock() && readModified(path, modified)
+        && (modified.tv_sec != compiled->modified.tv_sec || modified.tv_nsec != compiled->modified.tv_nsec))
+    {
+        /* A file caught halfway through being replaced is tried again next second */
+        if (std::shared_ptr<const Program> reloaded = compile(path))
+        {
+            program.store(reloaded);
+            compiled = std::move(reloaded);
+        }
+    }
+    return compiled;
+}
+
+std::shared_ptr<const Template::Program>
+Template::compile(const std::string& path)
+{
+    auto compiled = std::make_shared<Program>();
+    if (!readModified(path, compiled->modified))
+    {
+        return nullptr;
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return nullptr;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    compiled->source = buffer.str();
+
+    std::string_view source = compiled->source;
+    auto addLiteral = [&compiled](std::string_view text)
+    {
+        if (!text.empty())
+        {
+            compiled->code.push_back(Instruction{Instruction::Kind::Literal, 0, text});
+            compiled->literalSize += text.size();
+        }
+    };
+    auto slotIndex = [&compiled](std::string_view name)
+    {
+        for (size_t i = 0; i < compiled->slots.size(); ++i)
+        {
+            if (compiled->slots[i] == name)
+            {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        compiled->slots.emplace_back(name);
+        return static_cast<uint32_t>(compiled->slots.size() - 1);
+    };
+
+    size_t pos = 0;
+    while (pos < source.size())
+    {
+        size_t open = source.find("{{", pos);
+        if (open == std::string_view::npos)
+        {
+            break;
+        }
+        bool raw = source.substr(open, 3) == "{{{";
+        std::string_view closing = raw ? "}}}" : "}}";
+        size_t nameStart = open + closing.size();
+        size_t close = source.find(closing, nameStart);
+        if (close == std::string_view::npos)
+        {
+            /* Unterminated: the rest is text */
+            break;
+        }
+        addLiteral(source.substr(pos, open - pos));
+        Instruction::Kind kind = raw ? Instruction::Kind::Raw : Instruction::Kind::Escaped;
+        compiled->code.push_back(Instruction{kind, slotIndex(trim(source.substr(nameStart, close - nameStart))), {}});
+        pos = close + closing.size();
+    }
+    addLiteral(source.substr(pos));
+    return compiled;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <ctime>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * An HTML file compiled once into literal segments and variable slots.
+ * `{{name}}` is replaced by the value named `name`, HTML-escaped; `{{{name}}}`
+ * is replaced by it as it is. Rendering appends the segments and values in
+ * order, with nothing parsed or looked up by name per segment.
+ *
+ * The file is checked for changes at most once a second, by whichever thread
+ * renders it next, and recompiled when it has changed; renders already
+ * running finish with the old version.
+ */
+class Template
+{
+public:
+    using Values = std::initializer_list<std::pair<std::string_view, std::string_view>>;
+
+    /* Compiles `path` right away; a file that can't be read is logged and renders as nothing */
+    explicit Template(std::string path);
+
+    Template(const Template&) = delete;
+    Template& operator=(const Template&) = delete;
+
+    /* Slots without a value render as nothing */
+    void render(Values values, std::pmr::string& out) const;
+
+    /* Appends `text` with & < > " ' replaced by their entities */
+    static void escapeHtml(std::string_view text, std::pmr::string& out);
+
+private:
+    struct Instruction
+    {
+        enum class Kind : uint8_t
+        {
+            Literal,
+            Escaped,
+            Raw
+        };
+
+        Kind kind;
+        uint32_t slot;          /* Escaped and Raw */
+        std::string_view text;  /* Literal, a view into the program's source */
+    };
+
+    struct Program
+    {
+        std::string source;
+        std::vector<Instruction> code;
+        std::vector<std::string> slots;
+        size_t literalSize = 0;
+        timespec modified = {};
+    };
+
+    std::string path;
+    mutable std::atomic<std::shared_ptr<const Program>> program;
+    mutable std::atomic<time_t> checkedAt;
+    mutable std::mutex reloading;
+
+    std::shared_ptr<const Program> current() const;
+    static std::shared_ptr<const Program> compile(const std::string& path);
+};
@@ -1,46 +1,226 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(size_t numThreads)
-    : stop(false)
+namespace
 {
+    thread_local Priority runningPriority = Priority::Normal;
+
+    inline void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#else
+        std::this_thread::yield();
+#endif
+    }
+}
+
+ThreadPool::ThreadPool(size_t numThreads, Scheduling scheduling)
+    : scheduling(scheduling), pending(0), spinning(0), stop(false)
+{
+    /* Default weights: high priority work gets most of the turns, but low is never starved */
+    setWeights({8, 4, 1});
+    setSpinPolicy(SpinPolicy());
+
     for (size_t i = 0; i < numThreads; ++i)
     {
         workers.emplace_back([this] 
         {
-            while (true)
-            {
-                std::function<void()> task;
+            workerLoop();
+        });
+    }
+}
 
-                {
-                    std::unique_lock<std::mutex> lock(this->queueMutex);
-                    this->condition.wait(lock, [this] {
-                        return this->stop || !this->tasks.empty();
-                    });
+ThreadPool::~ThreadPool()
+{
+    stop.store(true, std::memory_order_seq_cst);
+    idle.notifyAll();
 
-                    if (this->stop && this->tasks.empty()) {
-                        return;
-                    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
 
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
-                }
+void
+ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        QueuedTask task;
+        if (tryPop(task))
+        {
+            runningPriority = task.priority;
+            task.fn();
+            continue;
+        }
 
-                task();
-            }
-        });
+        if (stop.load(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        if (spinForWork())
+        {
+            continue;
+        }
+
+        /* Park; re-check after announcing ourselves so a concurrent enqueue cannot be missed */
+        EventCount::Key key = idle.prepareWait();
+        if (pending.load(std::memory_order_seq_cst) > 0 || stop.load(std::memory_order_seq_cst))
+        {
+            idle.cancelWait();
+            continue;
+        }
+        idle.commitWait(key);
     }
 }
 
-ThreadPool::~ThreadPool()
+bool
+ThreadPool::tryPop(QueuedTask& task)
 {
+    if (pending.load(std::memory_order_acquire) == 0)
     {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        stop = true;
+        return false;
     }
-    condition.notify_all();
 
-    for (std::thread &worker : workers)
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (pending.load(std::memory_order_relaxed) == 0)
     {
-        worker.join();
+        return false;
     }
-}
\ No newline at end of file
+    task = popTask();
+    return true;
+}
+
+bool
+ThreadPool::spinForWork()
+{
+    spinning.fetch_add(1, std::memory_order_seq_cst);
+
+    bool found = false;
+    unsigned spent = 0;
+    unsigned limit = spinLimit.load(std::memory_order_relaxed);
+    unsigned burstLimit = maxBackoff.load(std::memory_order_relaxed);
+    for (unsigned burst = 1; spent < limit && !found; burst = burst < burstLimit ? burst * 2 : burstLimit)
+    {
+        for (unsigned i = 0; i < burst; ++i)
+        {
+            cpuRelax();
+        }
+        spent += burst;
+        found = pending.load(std::memory_order_acquire) > 0 || stop.load(std::memory_order_relaxed);
+    }
+
+    unsigned yields = yieldLimit.load(std::memory_order_relaxed);
+    for (unsigned i = 0; i < yields && !found; ++i)
+    {
+        std::this_thread::yield();
+        found = pending.load(std::memory_order_acquire) > 0 || stop.load(std::memory_order_relaxed);
+    }
+
+    spinning.fetch_sub(1, std::memory_order_seq_cst);
+    return found;
+}
+
+void
+ThreadPool::wakeWorker()
+{
+    /* Spinning workers re-check `pending` before they park, so if there is one per task no syscall is needed */
+    if (spinning.load(std::memory_order_seq_cst) >= pending.load(std::memory_order_seq_cst))
+    {
+        return;
+    }
+    idle.notifyOne();
+}
+
+void
+ThreadPool::setSpinPolicy(const SpinPolicy& policy)
+{
+    spinLimit.store(policy.spinLimit, std::memory_order_relaxed);
+    maxBackoff.store(policy.maxBackoff > 0 ? policy.maxBackoff : 1, std::memory_order_relaxed);
+    yieldLimit.store(policy.yieldLimit, std::memory_order_relaxed);
+}
+
+void
+ThreadPool::setWeights(const std::array<unsigned, LaneCount>& weights)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (size_t i = 0; i < LaneCount; ++i)
+    {
+        lanes[i].weight = weights[i] > 0 ? weights[i] : 1;
+        lanes[i].credit = lanes[i].weight;
+    }
+}
+
+ThreadPool::LaneStats
+ThreadPool::laneStats(Priority priority) const
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    const Lane& lane = lanes[static_cast<size_t>(priority)];
+    LaneStats stats = lane.stats;
+    stats.depth = lane.tasks.size();
+    return stats;
+}
+
+Priority
+ThreadPool::currentPriority()
+{
+    return runningPriority;
+}
+
+ThreadPool::Lane*
+ThreadPool::selectLane()
+{
+    if (scheduling == Scheduling::Strict)
+    {
+        for (Lane& lane : lanes)
+        {
+            if (!lane.tasks.empty())
+            {
+                return &lane;
+            }
+        }
+        return nullptr;
+    }
+
+    /* Weighted: take from the highest lane that still has credit this round, refill when all spent */
+    for (int round = 0; round < 2; ++round)
+    {
+        for (Lane& lane : lanes)
+        {
+            if (!lane.tasks.empty() && lane.credit > 0)
+            {
+                --lane.credit;
+                return &lane;
+            }
+        }
+
+        for (Lane& lane : lanes)
+        {
+            lane.credit = lane.weight;
+        }
+    }
+    return nullptr;
+}
+
+ThreadPool::QueuedTask
+ThreadPool::popTask()
+{
+    /* Caller holds queueMutex and guarantees pending > 0 */
+    Lane* lane = selectLane();
+
+    QueuedTask task = std::move(lane->tasks.front());
+    lane->tasks.pop();
+    pending.fetch_sub(1, std::memory_order_relaxed);
+
+    uint64_t waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - task.enqueuedAt).count();
+    ++lane->stats.executed;
+    lane->stats.totalWaitNs += waitNs;
+    if (waitNs > lane->stats.maxWaitNs)
+    {
+        lane->stats.maxWaitNs = waitNs;
+    }
+    return task;
+}
@@ -3,34 +3,115 @@
 #include <thread>
 #include <queue>
 #include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <mutex>
-#include <condition_variable>
+#include "EventCount.h"
 
-class ThreadPool 
+/* Scheduling class of a task, lower value is served first */
+enum class Priority : uint8_t
+{
+    High,
+    Normal,
+    Low
+};
+
+class ThreadPool
 {
 public:
-    ThreadPool(size_t numThreads);
+    static constexpr size_t LaneCount = 3;
+
+    enum class Scheduling
+    {
+        Strict,     /* Always drain the highest non-empty lane first */
+        Weighted    /* Serve lanes round-robin, up to `weight` tasks per round */
+    };
+
+    struct LaneStats
+    {
+        uint64_t enqueued = 0;
+        uint64_t executed = 0;
+        uint64_t totalWaitNs = 0;
+        uint64_t maxWaitNs = 0;
+        size_t depth = 0;
+    };
+
+    /*
+     * How an idle worker waits before parking on the futex: spin with `pause`,
+     * doubling the burst up to maxBackoff, until spinLimit pauses are spent,
+     * then sched_yield up to yieldLimit times. Zero limits park immediately.
+     */
+    struct SpinPolicy
+    {
+        unsigned spinLimit = 1024;
+        unsigned maxBackoff = 64;
+        unsigned yieldLimit = 4;
+    };
+
+    ThreadPool(size_t numThreads, Scheduling scheduling = Scheduling::Weighted);
     ~ThreadPool();
-    
+
     template<class F>
-    void enqueue(F&& f);
+    void enqueue(F&& f, Priority priority = Priority::Normal);
+
+    void setWeights(const std::array<unsigned, LaneCount>& weights);
+    void setSpinPolicy(const SpinPolicy& policy);
+    LaneStats laneStats(Priority priority) const;
+
+    /* Lane of the task running on the calling worker thread */
+    static Priority currentPriority();
 
 private:
+    using Clock = std::chrono::steady_clock;
+
+    struct QueuedTask
+    {
+        std::function<void()> fn;
+        Clock::time_point enqueuedAt;
+        Priority priority;
+    };
+
+    struct Lane
+    {
+        std::queue<QueuedTask> tasks;
+        unsigned weight = 1;
+        unsigned credit = 0;
+        LaneStats stats;
+    };
+
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::array<Lane, LaneCount> lanes;
+    Scheduling scheduling;
+    std::atomic<size_t> pending;
+
+    mutable std::mutex queueMutex;
+    EventCount idle;
+    std::atomic<unsigned> spinning;
+    std::atomic<unsigned> spinLimit;
+    std::atomic<unsigned> maxBackoff;
+    std::atomic<unsigned> yieldLimit;
+    std::atomic<bool> stop;
 
-    std::mutex queueMutex;
-    std::condition_variable condition;
-    bool stop;
+    void workerLoop();
+    bool tryPop(QueuedTask& task);
+    bool spinForWork();
+    Lane* selectLane();
+    QueuedTask popTask();
+    void wakeWorker();
 };
 
 template<class F>
-void ThreadPool::enqueue(F&& f)
+void ThreadPool::enqueue(F&& f, Priority priority)
 {
     {
         std::unique_lock<std::mutex> lock(queueMutex);
-        tasks.emplace(std::forward<F>(f));
+        Lane& lane = lanes[static_cast<size_t>(priority)];
+        lane.tasks.push({std::function<void()>(std::forward<F>(f)), Clock::now(), priority});
+        ++lane.stats.enqueued;
+        pending.fetch_add(1, std::memory_order_seq_cst);
     }
-    condition.notify_one();
-}
\ No newline at end of file
+    wakeWorker();
+}
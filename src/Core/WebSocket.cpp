@@ -0,0 +1,444 @@
+#include "WebSocket.h"
+
+#include <algorithm>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr std::string_view HANDSHAKE_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    constexpr size_t MAX_CONTROL_PAYLOAD = 125;
+
+    uint32_t rotateLeft(uint32_t value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    /* Only used for the handshake, so a plain byte-at-a-time SHA-1 is enough */
+    void sha1(std::string_view data, uint8_t digest[20])
+    {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+        std::string padded(data);
+        padded.push_back(static_cast<char>(0x80));
+        while (padded.size() % 64 != 56)
+        {
+            padded.push_back('\0');
+        }
+        uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            padded.push_back(static_cast<char>(bits >> shift));
+        }
+
+        for (size_t block = 0; block < padded.size(); block += 64)
+        {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i)
+            {
+                const auto* p = reinterpret_cast<const uint8_t*>(padded.data() + block + i * 4);
+                w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+            }
+            for (int i = 16; i < 80; ++i)
+            {
+                w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; ++i)
+            {
+                uint32_t f, k;
+                if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+                else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+                else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+                else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+
+                uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotateLeft(b, 30);
+                b = a;
+                a = temp;
+            }
+            h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+        }
+
+        for (int i = 0; i < 5; ++i)
+        {
+            digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+            digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+            digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+            digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+        }
+    }
+
+    std::string base64(const uint8_t* data, size_t size)
+    {
+        static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        out.reserve((size + 2) / 3 * 4);
+        for (size_t i = 0; i < size; i += 3)
+        {
+            uint32_t group = uint32_t(data[i]) << 16;
+            if (i + 1 < size) group |= uint32_t(data[i + 1]) << 8;
+            if (i + 2 < size) group |= uint32_t(data[i + 2]);
+            out.push_back(alphabet[(group >> 18) & 63]);
+            out.push_back(alphabet[(group >> 12) & 63]);
+            out.push_back(i + 1 < size ? alphabet[(group >> 6) & 63] : '=');
+            out.push_back(i + 2 < size ? alphabet[group & 63] : '=');
+        }
+        return out;
+    }
+
+    /* Text messages and close reasons must be UTF-8 (no overlongs, surrogates or values past U+10FFFF) */
+    bool isValidUtf8(std::string_view text)
+    {
+        const auto* p = reinterpret_cast<const uint8_t*>(text.data());
+        const uint8_t* end = p + text.size();
+        while (p < end)
+        {
+            /* ASCII runs eight bytes at a time */
+            uint64_t word;
+            if (end - p >= 8 && (std::memcpy(&word, p, 8), (word & 0x8080808080808080ULL) == 0))
+            {
+                p += 8;
+                continue;
+            }
+
+            uint8_t c = *p;
+            size_t length;
+            uint32_t min;
+            uint32_t codePoint;
+            if (c < 0x80) { ++p; continue; }
+            else if ((c & 0xE0) == 0xC0) { length = 2; min = 0x80; codePoint = c & 0x1F; }
+            else if ((c & 0xF0) == 0xE0) { length = 3; min = 0x800; codePoint = c & 0x0F; }
+            else if ((c & 0xF8) == 0xF0) { length = 4; min = 0x10000; codePoint = c & 0x07; }
+            else return false;
+
+            if (static_cast<size_t>(end - p) < length)
+            {
+                return false;
+            }
+            for (size_t i = 1; i < length; ++i)
+            {
+                if ((p[i] & 0xC0) != 0x80)
+                {
+                    return false;
+                }
+                codePoint = (codePoint << 6) | (p[i] & 0x3F);
+            }
+            if (codePoint < min || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+            {
+                return false;
+            }
+            p += length;
+        }
+        return true;
+    }
+
+    bool isValidCloseCode(uint16_t code)
+    {
+        return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+    }
+
+    std::string closePayload(uint16_t code, std::string_view reason)
+    {
+        std::string payload;
+        payload.push_back(static_cast<char>(code >> 8));
+        payload.push_back(static_cast<char>(code));
+        payload.append(reason.substr(0, MAX_CONTROL_PAYLOAD - 2));
+        return payload;
+    }
+}
+
+WebSocket::WebSocket(Priority priority, size_t maxMessageSize, size_t maxBackpressure, Writer writer)
+    : connection(nullptr), handshake(nullptr), inboxBytes(0), running(false), closeSent(false),
+      closeCode(Abnormal), priority(priority), posted(0), queued(0), backpressured(false),
+      maxMessageSize(maxMessageSize), maxBackpressure(maxBackpressure), writer(std::move(writer)), open(true),
+      inFrame(false), fin(false), opcode(0), mask{}, remaining(0), maskOffset(0), messageOpcode(0)
+{
+}
+
+bool
+WebSocket::send(std::string_view message, bool binary)
+{
+    if (!isOpen())
+    {
+        return false;
+    }
+    if (bufferedAmount() > maxBackpressure)
+    {
+        backpressured.store(true, std::memory_order_relaxed);
+        return false;
+    }
+
+    std::string bytes = frame(binary ? Binary : Text, message);
+    posted.fetch_add(bytes.size(), std::memory_order_relaxed);
+    writer(shared_from_this(), std::move(bytes));
+    return true;
+}
+
+void
+WebSocket::close(uint16_t code, std::string_view reason)
+{
+    if (!open.exchange(false, std::memory_order_acq_rel))
+    {
+        return;
+    }
+    std::string bytes = frame(Close, closePayload(code, reason));
+    posted.fetch_add(bytes.size(), std::memory_order_relaxed);
+    writer(shared_from_this(), std::move(bytes));
+}
+
+bool
+WebSocket::admit(std::string_view bytes)
+{
+    if (closeSent)
+    {
+        return false;
+    }
+    if ((static_cast<uint8_t>(bytes[0]) & 0x0F) == Close)
+    {
+        closeSent = true;
+        closeCode = bytes.size() >= 4 ? static_cast<uint16_t>((static_cast<uint8_t>(bytes[2]) << 8) | static_cast<uint8_t>(bytes[3])) : static_cast<uint16_t>(NoStatus);
+        closeReason.assign(bytes.size() > 4 ? bytes.substr(4) : std::string_view());
+    }
+    return true;
+}
+
+std::string
+WebSocket::acceptKey(std::string_view key)
+{
+    std::string input(key);
+    input.append(HANDSHAKE_GUID);
+    uint8_t digest[20];
+    sha1(input, digest);
+    return base64(digest, sizeof(digest));
+}
+
+void
+WebSocket::unmask(const char* in, char* out, size_t size, const uint8_t mask[4], size_t offset)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    if (size >= 16)
+    {
+        /* 16 is a multiple of 4, so every block lines up with the same rotation of the key */
+        alignas(16) uint8_t key[16];
+        for (size_t k = 0; k < 16; ++k)
+        {
+            key[k] = mask[(offset + k) & 3];
+        }
+        const __m128i keyVector = _mm_load_si128(reinterpret_cast<const __m128i*>(key));
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(chunk, keyVector));
+        }
+    }
+#endif
+    for (; i < size; ++i)
+    {
+        out[i] = static_cast<char>(in[i] ^ mask[(offset + i) & 3]);
+    }
+}
+
+std::string
+WebSocket::frame(uint8_t opcode, std::string_view payload)
+{
+    /* Server frames are never masked */
+    std::string bytes;
+    bytes.reserve(payload.size() + 10);
+    bytes.push_back(static_cast<char>(0x80 | opcode));
+    if (payload.size() < 126)
+    {
+        bytes.push_back(static_cast<char>(payload.size()));
+    }
+    else if (payload.size() <= 0xFFFF)
+    {
+        bytes.push_back(126);
+        bytes.push_back(static_cast<char>(payload.size() >> 8));
+        bytes.push_back(static_cast<char>(payload.size()));
+    }
+    else
+    {
+        bytes.push_back(127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            bytes.push_back(static_cast<char>(static_cast<uint64_t>(payload.size()) >> shift));
+        }
+    }
+    bytes.append(payload);
+    return bytes;
+}
+
+size_t
+WebSocket::receive(std::string_view input, std::string& replies)
+{
+    size_t pos = 0;
+    while (!closeSent && pos < input.size())
+    {
+        if (!inFrame)
+        {
+            const auto* header = reinterpret_cast<const uint8_t*>(input.data() + pos);
+            size_t available = input.size() - pos;
+            if (available < 2)
+            {
+                break;
+            }
+            if (!(header[1] & 0x80) || (header[0] & 0x70))
+            {
+                /* Clients must mask, and no extension that would use the RSV bits was negotiated */
+                fail(ProtocolError, replies);
+                break;
+            }
+
+            uint8_t shortLength = header[1] & 0x7F;
+            size_t lengthBytes = shortLength == 126 ? 2 : shortLength == 127 ? 8 : 0;
+            size_t headerSize = 2 + lengthBytes + 4;
+            if (available < headerSize)
+            {
+                break;
+            }
+
+            uint64_t length = shortLength;
+            if (lengthBytes > 0)
+            {
+                length = 0;
+                for (size_t i = 0; i < lengthBytes; ++i)
+                {
+                    length = (length << 8) | header[2 + i];
+                }
+            }
+
+            fin = header[0] & 0x80;
+            opcode = header[0] & 0x0F;
+            if (opcode >= Close)
+            {
+                if (!fin || length > MAX_CONTROL_PAYLOAD || opcode > Pong)
+                {
+                    fail(ProtocolError, replies);
+                    break;
+                }
+                control.clear();
+            }
+            else if (opcode == Continuation ? messageOpcode == 0 : (opcode > Binary || messageOpcode != 0))
+            {
+                /* Continuation without a message, a new message inside one, or a reserved opcode */
+                fail(ProtocolError, replies);
+                break;
+            }
+            else
+            {
+                if (opcode != Continuation)
+                {
+                    messageOpcode = opcode;
+                }
+                if (length > maxMessageSize - message.size())
+                {
+                    fail(MessageTooBig, replies);
+                    break;
+                }
+                message.reserve(message.size() + length);
+            }
+
+            std::memcpy(mask, header + 2 + lengthBytes, 4);
+            remaining = length;
+            maskOffset = 0;
+            inFrame = true;
+            pos += headerSize;
+        }
+
+        /* Payload may arrive over several reads; unmask what is here */
+        size_t take = static_cast<size_t>(std::min<uint64_t>(remaining, input.size() - pos));
+        std::string& target = opcode >= Close ? control : message;
+        size_t start = target.size();
+        target.resize(start + take);
+        unmask(input.data() + pos, target.data() + start, take, mask, maskOffset);
+        pos += take;
+        remaining -= take;
+        maskOffset = (maskOffset + take) & 3;
+        if (remaining > 0)
+        {
+            break;
+        }
+        inFrame = false;
+
+        if (opcode >= Close)
+        {
+            onControl(replies);
+            continue;
+        }
+        if (!fin)
+        {
+            continue;
+        }
+
+        if (messageOpcode == Text && !isValidUtf8(message))
+        {
+            fail(InvalidData, replies);
+            break;
+        }
+        inboxBytes += message.size();
+        inbox.push_back(Event{Event::Message, messageOpcode == Binary, 0, std::move(message)});
+        message = std::string();
+        messageOpcode = 0;
+    }
+    return pos;
+}
+
+void
+WebSocket::fail(uint16_t code, std::string& replies)
+{
+    replies.append(frame(Close, closePayload(code, {})));
+    open.store(false, std::memory_order_release);
+    closeSent = true;
+    closeCode = code;
+    closeReason.clear();
+}
+
+void
+WebSocket::onControl(std::string& replies)
+{
+    if (opcode == Ping)
+    {
+        replies.append(frame(Pong, control));
+        return;
+    }
+    if (opcode == Pong)
+    {
+        return;
+    }
+
+    /* Close: echo the code back and finish; the App closes the socket once it is written */
+    uint16_t code = NoStatus;
+    std::string_view reason;
+    if (control.size() == 1)
+    {
+        fail(ProtocolError, replies);
+        return;
+    }
+    if (control.size() >= 2)
+    {
+        code = static_cast<uint16_t>((static_cast<uint8_t>(control[0]) << 8) | static_cast<uint8_t>(control[1]));
+        reason = std::string_view(control).substr(2);
+        if (!isValidCloseCode(code))
+        {
+            fail(ProtocolError, replies);
+            return;
+        }
+        if (!isValidUtf8(reason))
+        {
+            fail(InvalidData, replies);
+            return;
+        }
+    }
+
+    replies.append(frame(Close, code == NoStatus ? std::string() : closePayload(code, {})));
+    open.store(false, std::memory_order_release);
+    closeSent = true;
+    closeCode = code;
+    closeReason.assign(reason);
+}
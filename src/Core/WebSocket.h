@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ThreadPool.h"
+
+class Connection;
+struct Exchange;
+
+/*
+ * One upgraded WebSocket connection (RFC 6455). The event loop feeds it the
+ * connection's input through receive(), which parses and unmasks frames,
+ * reassembles fragmented messages and answers pings. Complete messages wait
+ * in `inbox` until the App runs them on a worker, one batch at a time, so the
+ * callbacks of one socket never run concurrently and always run in order.
+ *
+ * send() and close() may be called from any thread. Outgoing frames go
+ * through the connection's write queue; once more than `maxBackpressure`
+ * bytes are waiting, send() drops the message and returns false, and onDrain
+ * runs when the queue has been written out.
+ */
+class WebSocket : public std::enable_shared_from_this<WebSocket>
+{
+public:
+    using MessageHandler = std::function<void(std::string_view message, bool binary)>;
+    using CloseHandler = std::function<void(uint16_t code, std::string_view reason)>;
+    using DrainHandler = std::function<void()>;
+    using Writer = std::function<void(std::shared_ptr<WebSocket> socket, std::string frame)>;
+
+    enum Opcode : uint8_t
+    {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xa
+    };
+
+    enum CloseCode : uint16_t
+    {
+        Normal = 1000,
+        GoingAway = 1001,
+        ProtocolError = 1002,
+        NoStatus = 1005,
+        Abnormal = 1006,
+        InvalidData = 1007,
+        MessageTooBig = 1009
+    };
+
+    /* Set these from the open handler */
+    MessageHandler onMessage;
+    CloseHandler onClose;
+    DrainHandler onDrain;
+
+    WebSocket(Priority priority, size_t maxMessageSize, size_t maxBackpressure, Writer writer);
+
+    WebSocket(const WebSocket&) = delete;
+    WebSocket& operator=(const WebSocket&) = delete;
+
+    /* Thread-safe; false if the socket is closing or the message was dropped under backpressure */
+    bool send(std::string_view message, bool binary = false);
+    void close(uint16_t code = Normal, std::string_view reason = {});
+    bool isOpen() const { return open.load(std::memory_order_acquire); }
+    /* Bytes sent but not yet written to the socket */
+    size_t bufferedAmount() const { return posted.load(std::memory_order_relaxed) + queued.load(std::memory_order_relaxed); }
+
+    /* Sec-WebSocket-Accept for a Sec-WebSocket-Key */
+    static std::string acceptKey(std::string_view key);
+    /* XORs `size` bytes with the mask, starting `offset` bytes into it */
+    static void unmask(const char* in, char* out, size_t size, const uint8_t mask[4], size_t offset);
+    static std::string frame(uint8_t opcode, std::string_view payload);
+
+public:
+    struct Event
+    {
+        enum Kind : uint8_t
+        {
+            Open,
+            Message,
+            Drain,
+            Closed
+        };
+
+        Kind kind;
+        bool binary = false;
+        uint16_t code = 0;
+        std::string data{};
+    };
+
+    /* Loop thread only */
+    Connection* connection;
+    Exchange* handshake;            /* Upgrade request, kept for the open handler */
+    std::vector<Event> inbox;
+    size_t inboxBytes;
+    bool running;                   /* A worker is running events from the inbox */
+    bool closeSent;
+    uint16_t closeCode;
+    std::string closeReason;
+    Priority priority;
+    std::atomic<size_t> posted;     /* Handed to the writer, not yet queued on the connection */
+    std::atomic<size_t> queued;     /* Queued on the connection, not yet written */
+    std::atomic<bool> backpressured; /* A send was dropped; onDrain is due once the queue empties */
+
+    /*
+     * Parses frames from `input`; returns the bytes consumed and appends pongs
+     * and close replies to `replies`. Stops once a close frame has been sent.
+     */
+    size_t receive(std::string_view input, std::string& replies);
+    /* Called with each frame from the writer before it is queued; false drops it (a close was already sent) */
+    bool admit(std::string_view bytes);
+
+private:
+    size_t maxMessageSize;
+    size_t maxBackpressure;
+    Writer writer;
+    std::atomic<bool> open;
+
+    /* Frame being received */
+    bool inFrame;
+    bool fin;
+    uint8_t opcode;
+    uint8_t mask[4];
+    uint64_t remaining;
+    size_t maskOffset;
+    std::string control;
+
+    /* Fragmented message being reassembled */
+    uint8_t messageOpcode;
+    std::string message;
+
+    void fail(uint16_t code, std::string& replies);
+    void onControl(std::string& replies);
+};
@@ -0,0 +1,128 @@
+#include "Core/Channel.h"
+#include "Core/Connection.h"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Fan-out throughput of Channel::publish to event stream subscribers, against
+ * serializing and copying the message for each subscriber. Delivery runs
+ * inline on the calling thread, as the event loop would run it, and every
+ * subscriber's output is written out right after it is queued.
+ *
+ * Subscribers are UDP sockets connected to one sink that never reads, so
+ * each costs one descriptor and every write is a real send that the kernel
+ * drops at the sink.
+ *
+ *   bench_channel [subscribers] [messages] [message size]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    int openSink(sockaddr_in& address)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), length) < 0
+            || getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) < 0)
+        {
+            std::perror("sink");
+            std::exit(1);
+        }
+        return fd;
+    }
+
+    void report(const char* name, size_t deliveries, Clock::duration elapsed)
+    {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        std::printf("%-8s %12zu %14.0f %10.1f\n", name, deliveries, deliveries / seconds, seconds * 1e9 / deliveries);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    size_t subscriberCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    size_t messages = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+    size_t messageSize = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 256;
+
+    rlimit files;
+    getrlimit(RLIMIT_NOFILE, &files);
+    files.rlim_cur = files.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &files);
+
+    sockaddr_in sinkAddress;
+    int sink = openSink(sinkAddress);
+
+    Channel channel("bench", SIZE_MAX, [](std::function<void()> task) { task(); },
+                    [](Connection* connection) { connection->flush(); });
+    std::vector<std::unique_ptr<Connection>> subscribers;
+    for (size_t i = 0; i < subscriberCount; ++i)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&sinkAddress), sizeof(sinkAddress)) < 0)
+        {
+            std::fprintf(stderr, "stopped at %zu subscribers: out of descriptors\n", i);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            break;
+        }
+        subscribers.push_back(std::make_unique<Connection>(fd));
+        subscribers.back()->eventStream = true;
+        channel.add(subscribers.back().get());
+    }
+
+    std::string data(messageSize, 'x');
+    size_t deliveries = messages * subscribers.size();
+    std::printf("%zu subscribers, %zu messages of %zu bytes\n", subscribers.size(), messages, messageSize);
+    std::printf("%-8s %12s %14s %10s\n", "mode", "deliveries", "deliveries/s", "ns each");
+
+    /* Serialized once per message, the same buffer queued on every subscriber */
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < messages; ++i)
+    {
+        channel.publish(data, "tick");
+    }
+    report("shared", deliveries, Clock::now() - start);
+
+    /* Serialized and copied for every subscriber */
+    start = Clock::now();
+    for (size_t i = 0; i < messages; ++i)
+    {
+        for (const std::unique_ptr<Connection>& connection : subscribers)
+        {
+            connection->queue(Channel::eventStreamMessage(data, "tick"));
+            connection->flush();
+        }
+    }
+    report("copied", deliveries, Clock::now() - start);
+
+    if (channel.droppedCount() > 0)
+    {
+        std::printf("%llu deliveries dropped\n", static_cast<unsigned long long>(channel.droppedCount()));
+    }
+
+    for (const std::unique_ptr<Connection>& connection : subscribers)
+    {
+        channel.remove(connection.get());
+    }
+    close(sink);
+    return 0;
+}
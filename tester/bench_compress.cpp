@@ -0,0 +1,97 @@
+#include "Core/Compression.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <zlib.h>
+
+/*
+ * CPU cost of gzip response compression against the bytes it saves, on a
+ * repetitive JSON array like an API listing. Each size and level is timed
+ * through compressBody, which resets a per-thread deflate stream, and with a
+ * stream set up and torn down for every body.
+ *
+ *   bench_compress [bytes processed per case]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::string makePayload(size_t size)
+    {
+        std::string payload = "[";
+        for (size_t i = 0; payload.size() < size; ++i)
+        {
+            payload += (i == 0 ? "" : ",");
+            payload += "{\"id\":" + std::to_string(i) + ",\"name\":\"user " + std::to_string(i)
+                + "\",\"email\":\"user" + std::to_string(i) + "@example.com\",\"active\":"
+                + (i % 3 == 0 ? "false" : "true") + ",\"score\":" + std::to_string(i * 37 % 1000) + "}";
+        }
+        payload += "]";
+        return payload;
+    }
+
+    /* What compressBody saves: a deflate stream built for this body alone */
+    size_t compressFresh(const std::string& body, std::pmr::string& compressed, const CompressionOptions& options)
+    {
+        z_stream stream{};
+        deflateInit2(&stream, options.level, Z_DEFLATED, options.windowBits + 16, options.memLevel, Z_DEFAULT_STRATEGY);
+        compressed.resize(deflateBound(&stream, body.size()));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+        stream.avail_in = static_cast<uInt>(body.size());
+        stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+        stream.avail_out = static_cast<uInt>(compressed.size());
+        deflate(&stream, Z_FINISH);
+        size_t size = stream.total_out;
+        deflateEnd(&stream);
+        return size;
+    }
+
+    template<class F>
+    double microsecondsEach(size_t iterations, F&& compress)
+    {
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            compress();
+        }
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    size_t perCase = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 32 * 1024 * 1024;
+
+    std::printf("gzip of a JSON array, time per body in us\n");
+    std::printf("%9s %5s %10s %7s %10s %10s\n", "size", "level", "gzipped", "saved", "reused", "fresh");
+    for (size_t size : {1024, 8 * 1024, 128 * 1024, 1024 * 1024})
+    {
+        std::string body = makePayload(size);
+        size_t iterations = perCase / body.size() + 1;
+        for (int level : {1, 6, 9})
+        {
+            CompressionOptions options;
+            options.level = level;
+            std::pmr::string compressed;
+
+            compressBody(body, compressed, ContentEncoding::Gzip, options);
+            size_t gzipped = compressed.size();
+            double reused = microsecondsEach(iterations, [&]
+            {
+                compressBody(body, compressed, ContentEncoding::Gzip, options);
+            });
+            double fresh = microsecondsEach(iterations, [&]
+            {
+                compressFresh(body, compressed, options);
+            });
+            std::printf("%9zu %5d %10zu %6.1f%% %10.1f %10.1f\n", body.size(), level, gzipped,
+                        100.0 - 100.0 * gzipped / body.size(), reused, fresh);
+        }
+    }
+    return 0;
+}
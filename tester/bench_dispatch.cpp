@@ -0,0 +1,96 @@
+#include "Core/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+/*
+ * Enqueue-to-execution latency of the ThreadPool. A producer enqueues tasks
+ * at a fixed rate; each task records how long after its enqueue it started.
+ * Every rate is run with workers that park at once and with the default spin
+ * policy. Spinning only pays off with a spare core per spinning worker, so
+ * the default leaves one core to the producer.
+ *
+ *   bench_dispatch [threads] [tasks per run]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Run
+    {
+        const char* policyName;
+        ThreadPool::SpinPolicy policy;
+        unsigned rate;      /* Tasks per second */
+    };
+
+    uint64_t percentile(const std::vector<uint64_t>& sorted, double p)
+    {
+        size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+        return sorted[index];
+    }
+
+    void measure(size_t threads, size_t tasks, const Run& run)
+    {
+        ThreadPool pool(threads);
+        pool.setSpinPolicy(run.policy);
+
+        std::vector<uint64_t> latencies(tasks);
+        std::atomic<size_t> done(0);
+        Clock::duration interval = std::chrono::nanoseconds(1000000000ull / run.rate);
+
+        /* Workers that just started aren't idle in the way being measured */
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        Clock::time_point next = Clock::now();
+        for (size_t i = 0; i < tasks; ++i)
+        {
+            /* Busy-wait, as sleeping would blur the rate at 100k/s and up */
+            while (Clock::now() < next)
+            {
+            }
+            next += interval;
+
+            Clock::time_point enqueuedAt = Clock::now();
+            pool.enqueue([&latencies, &done, i, enqueuedAt]
+            {
+                latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - enqueuedAt).count();
+                done.fetch_add(1, std::memory_order_release);
+            });
+        }
+        while (done.load(std::memory_order_acquire) < tasks)
+        {
+            std::this_thread::yield();
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        std::printf("%-6s %9u/s %9.1f %9.1f %9.1f %9.1f\n", run.policyName, run.rate,
+                    percentile(latencies, 0.50) / 1000.0, percentile(latencies, 0.90) / 1000.0,
+                    percentile(latencies, 0.99) / 1000.0, latencies.back() / 1000.0);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    size_t cores = std::thread::hardware_concurrency();
+    size_t threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : (cores > 1 ? cores - 1 : 1);
+    size_t tasks = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+
+    const ThreadPool::SpinPolicy park{0, 1, 0};
+    const ThreadPool::SpinPolicy spin{};
+
+    std::printf("%zu workers, %zu tasks per run, latency in us\n", threads, tasks);
+    std::printf("%-6s %11s %9s %9s %9s %9s\n", "policy", "rate", "p50", "p90", "p99", "max");
+    for (unsigned rate : {1000u, 10000u, 100000u, 500000u})
+    {
+        measure(threads, tasks, {"park", park, rate});
+        measure(threads, tasks, {"spin", spin, rate});
+    }
+    return 0;
+}
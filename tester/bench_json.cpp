@@ -0,0 +1,83 @@
+#include "Core/Json.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+
+/*
+ * Throughput of parseJson on generated request bodies from 1 KB to 1 MB:
+ * records like an API would receive, with escaped strings and nesting, and a
+ * flat array of numbers. Each document is parsed into a monotonic arena that
+ * is released between runs, as the request arena is between requests.
+ *
+ *   bench_json [bytes parsed per case]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::string makeRecords(size_t size)
+    {
+        std::string text = "{\"items\":[";
+        for (size_t i = 0; text.size() < size; ++i)
+        {
+            text += (i == 0 ? "" : ",");
+            text += "{\"id\":" + std::to_string(i) + ",\"name\":\"item \\\"" + std::to_string(i)
+                + "\\\"\",\"tags\":[\"a\",\"b\\n\",\"caf\\u00e9\"],\"price\":" + std::to_string(i % 500) + ".25"
+                + ",\"stock\":{\"count\":" + std::to_string(i * 7 % 100) + ",\"open\":" + (i % 2 ? "true" : "false")
+                + ",\"note\":null}}";
+        }
+        text += "]}";
+        return text;
+    }
+
+    std::string makeNumbers(size_t size)
+    {
+        std::string text = "[";
+        for (size_t i = 0; text.size() < size; ++i)
+        {
+            text += (i == 0 ? "" : ", ");
+            text += std::to_string(i * 2654435761u % 1000000) + "." + std::to_string(i % 97) + "e-3";
+        }
+        text += "]";
+        return text;
+    }
+
+    void measure(const char* shape, const std::string& text, size_t perCase)
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        if (!parseJson(text, &arena))
+        {
+            std::fprintf(stderr, "%s payload of %zu bytes did not parse\n", shape, text.size());
+            std::exit(1);
+        }
+
+        size_t iterations = perCase / text.size() + 1;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            arena.release();
+            parseJson(text, &arena);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::printf("%-8s %9zu %10.1f %9.0f\n", shape, text.size(), seconds * 1e6 / iterations,
+                    text.size() * iterations / seconds / (1024 * 1024));
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    size_t perCase = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256 * 1024 * 1024;
+
+    std::printf("%-8s %9s %10s %9s\n", "shape", "bytes", "us each", "MB/s");
+    for (size_t size : {1024, 16 * 1024, 128 * 1024, 1024 * 1024})
+    {
+        measure("records", makeRecords(size), perCase);
+        measure("numbers", makeNumbers(size), perCase);
+    }
+    return 0;
+}
@@ -21,9 +21,7 @@ int main() {
         res.send("Hello, World!");
     });
 
-    app.get("/goodbye", [](const Request& req, Response& res) {
-        res.send("Goodbye, World!");
-    });
+    app.getStatic("/goodbye", "Goodbye, World!");
 
     app.listen(8080, []() {
         flog::info("Server started.");
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include "Core/App.h"
+
+/* Reports a failed expectation and keeps going; the test exits non-zero at the end */
+#define CHECK(condition)                                                            \
+    do                                                                              \
+    {                                                                               \
+        if (!(condition))                                                           \
+        {                                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++testFailures;                                                         \
+        }                                                                           \
+    } while (0)
+
+inline int testFailures = 0;
+
+inline int
+connectTo(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Runs `app` on `port` in the background; returns once it accepts connections */
+inline void
+startServer(App& app, int port)
+{
+    std::thread([&app, port] { app.listen(port, nullptr); }).detach();
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        int fd = connectTo(port);
+        if (fd >= 0)
+        {
+            close(fd);
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::fprintf(stderr, "server on port %d did not start\n", port);
+    std::_Exit(1);
+}
+
+/* Sends `request` on a new connection and returns everything read until the server closes it */
+inline std::string
+roundTrip(int port, std::string_view request)
+{
+    int fd = connectTo(port);
+    if (fd < 0)
+    {
+        return {};
+    }
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+    std::string response;
+    char buffer[65536];
+    pollfd readable{fd, POLLIN, 0};
+    while (poll(&readable, 1, 5000) > 0)
+    {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+            break;
+        }
+        response.append(buffer, received);
+    }
+    close(fd);
+    return response;
+}
+
+/* The server threads never stop, so the process ends here */
+inline int
+finish()
+{
+    std::fflush(stderr);
+    std::_Exit(testFailures == 0 ? 0 : 1);
+}
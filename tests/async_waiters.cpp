@@ -0,0 +1,37 @@
+#include <future>
+#include <sys/socket.h>
+#include "TestClient.h"
+
+int
+main()
+{
+    /* One end of a socket pair, awaited for reading and for writing by two handlers at once */
+    int pair[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair);
+
+    App app(2);
+    app.get("/read", [&app, &pair](const Request&, Response& res) -> Task<>
+    {
+        char byte = 0;
+        ssize_t received = co_await app.read(pair[0], &byte, 1);
+        res.send(received == 1 ? std::string(1, byte) : std::string("failed"));
+    });
+    app.get("/write", [&app, &pair](const Request&, Response& res) -> Task<>
+    {
+        co_await app.writable(pair[0]);
+        [[maybe_unused]] ssize_t sent = ::write(pair[1], "r", 1);
+        res.send("written");
+    });
+    startServer(app, 18105);
+
+    auto reader = std::async(std::launch::async, []
+    {
+        return roundTrip(18105, "GET /read HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    /* The writer's wait must not displace the reader's */
+    CHECK(roundTrip(18105, "GET /write HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n").ends_with("written"));
+    CHECK(reader.get().ends_with("\r\n\r\nr"));
+    return finish();
+}
@@ -0,0 +1,18 @@
+#include "TestClient.h"
+#include "Core/Channel.h"
+
+int
+main()
+{
+    CHECK(Channel::eventStreamMessage("hello", {}) == "data: hello\n\n");
+    CHECK(Channel::eventStreamMessage("hello", "tick") == "event: tick\ndata: hello\n\n");
+
+    /* Each of CRLF, CR and LF ends a data line */
+    CHECK(Channel::eventStreamMessage("a\r\nb\rc\nd", {}) == "data: a\ndata: b\ndata: c\ndata: d\n\n");
+    CHECK(Channel::eventStreamMessage("a\r\r\nb\n", {}) == "data: a\ndata: \ndata: b\ndata: \n\n");
+
+    /* Nothing in a message can add fields or end the event early */
+    CHECK(Channel::eventStreamMessage("x\rid: 7\revent: evil", {}) == "data: x\ndata: id: 7\ndata: event: evil\n\n");
+    CHECK(Channel::eventStreamMessage("x", "tick\r\ndata: evil\r\r") == "event: tickdata: evil\ndata: x\n\n");
+    return finish();
+}
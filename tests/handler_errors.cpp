@@ -0,0 +1,23 @@
+#include <stdexcept>
+#include "TestClient.h"
+
+int
+main()
+{
+    App app(2);
+    app.get("/throw", [](const Request&, Response&) { throw std::runtime_error("handler failed"); });
+    app.get("/ok", [](const Request&, Response& res) { res.send("fine"); });
+    startServer(app, 18101);
+
+    /* The failing request gets a 500 and the connection carries on to the next one */
+    std::string response = roundTrip(18101,
+        "GET /throw HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /ok HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    CHECK(response.starts_with("HTTP/1.1 500 Internal Server Error\r\n"));
+    CHECK(response.find("HTTP/1.1 200 OK\r\n") != std::string::npos);
+    CHECK(response.ends_with("fine"));
+
+    /* The server survived */
+    CHECK(roundTrip(18101, "GET /ok HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n").ends_with("fine"));
+    return finish();
+}
@@ -0,0 +1,52 @@
+#include <chrono>
+#include "TestClient.h"
+
+namespace
+{
+    /* A HEAD answered with its head only, then the GET behind it on the same connection */
+    void checkHeadThenGet(int port, const std::string& path, const std::string& body)
+    {
+        std::string response = roundTrip(port,
+            "HEAD " + path + " HTTP/1.1\r\nHost: x\r\n\r\n"
+            "GET " + path + " HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+
+        size_t headEnd = response.find("\r\n\r\n");
+        CHECK(headEnd != std::string::npos);
+        std::string head = response.substr(0, headEnd + 4);
+        std::string rest = response.substr(head.size());
+        CHECK(head.starts_with("HTTP/1.1 200 OK\r\n"));
+        CHECK(head.find("Content-Length: " + std::to_string(body.size()) + "\r\n") != std::string::npos);
+        CHECK(rest.starts_with("HTTP/1.1 200 OK\r\n"));
+        CHECK(rest.ends_with("\r\n\r\n" + body));
+    }
+}
+
+int
+main()
+{
+    App app(2);
+    std::string large(8000, 'x');
+    app.get("/small", [](const Request&, Response& res) { res.send("small body"); });
+    app.get("/large", [&large](const Request&, Response& res) { res.send(large); });
+    app.getStatic("/static", "static body");
+    app.get("/cached", [](const Request&, Response& res) { res.send("cached body"); },
+            CacheOptions{.ttl = std::chrono::seconds(60)});
+    startServer(app, 18102);
+
+    checkHeadThenGet(18102, "/small", "small body");
+    checkHeadThenGet(18102, "/large", large);
+    checkHeadThenGet(18102, "/static", "static body");
+    /* Once to fill the cache, once answered from it */
+    checkHeadThenGet(18102, "/cached", "cached body");
+    checkHeadThenGet(18102, "/cached", "cached body");
+
+    /* A constant route answers GET and HEAD only, other methods get a 405 and no body */
+    std::string response = roundTrip(18102,
+        "POST /static HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\n\r\nabc"
+        "DELETE /static HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    CHECK(response.starts_with("HTTP/1.1 405 Method Not Allowed\r\n"));
+    CHECK(response.find("Allow: GET, HEAD\r\n") != std::string::npos);
+    CHECK(response.find("static body") == std::string::npos);
+    CHECK(response.find("HTTP/1.1 405", 1) != std::string::npos);
+    return finish();
+}
@@ -0,0 +1,364 @@
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "TestClient.h"
+#include "Core/Hpack.h"
+#include "Core/Http2.h"
+
+namespace
+{
+    using Fields = std::vector<std::pair<std::string, std::string>>;
+
+    std::string fromHex(std::string_view hex)
+    {
+        std::string bytes;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2)
+        {
+            bytes.push_back(static_cast<char>(std::stoi(std::string(hex.substr(i, 2)), nullptr, 16)));
+        }
+        return bytes;
+    }
+
+    bool decode(HpackDecoder& decoder, std::string_view block, Fields& fields)
+    {
+        fields.clear();
+        return decoder.decode(block, [&fields](std::string_view name, std::string_view value)
+        {
+            fields.emplace_back(name, value);
+        });
+    }
+
+    /* RFC 7541 C.3 (plain literals) or C.4 (Huffman): three requests through one decoder */
+    void checkRequestVectors(const char* first, const char* second, const char* third)
+    {
+        HpackDecoder decoder;
+        Fields fields;
+        CHECK(decode(decoder, fromHex(first), fields));
+        CHECK((fields == Fields{{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}}));
+        CHECK(decode(decoder, fromHex(second), fields));
+        CHECK((fields == Fields{{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"},
+                                {"cache-control", "no-cache"}}));
+        CHECK(decode(decoder, fromHex(third), fields));
+        CHECK((fields == Fields{{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"},
+                                {":authority", "www.example.com"}, {"custom-key", "custom-value"}}));
+    }
+
+    void checkEncoderRoundTrip()
+    {
+        const std::vector<Fields> blocks = {
+            {{":status", "200"}, {"content-type", "text/plain"}, {"x-request", "1"}, {"date", "Mon, 21 Oct 2013 20:13:21 GMT"}},
+            {{":status", "200"}, {"content-type", "text/plain"}, {"x-request", "2"}, {"date", "Mon, 21 Oct 2013 20:13:22 GMT"}},
+            {{":status", "404"}, {"content-type", "text/html; charset=utf-8"}, {"x-empty", ""}, {"x-request", "2"}},
+        };
+
+        HpackEncoder encoder;
+        HpackDecoder decoder;
+        Fields fields;
+        for (size_t round = 0; round < 2; ++round)
+        {
+            for (const Fields& block : blocks)
+            {
+                std::string bytes;
+                encoder.beginBlock(bytes);
+                for (const auto& [name, value] : block)
+                {
+                    encoder.encode(name, value, bytes, name != "date");
+                }
+                CHECK(decode(decoder, bytes, fields));
+                CHECK(fields == block);
+            }
+            /* The second round starts with a size update and a smaller table */
+            encoder.setMaxTableSize(64);
+        }
+
+        std::string text = "Mon, 21 Oct 2013 20:13:21 GMT \x01\xff";
+        std::string huffman;
+        std::string decoded;
+        Huffman::encode(text, huffman);
+        CHECK(huffman.size() == Huffman::encodedLength(text));
+        CHECK(Huffman::decode(huffman, decoded) && decoded == text);
+    }
+
+    void writeFrame(std::string& out, uint8_t type, uint8_t flags, uint32_t streamId, std::string_view payload)
+    {
+        out.push_back(static_cast<char>(payload.size() >> 16));
+        out.push_back(static_cast<char>(payload.size() >> 8));
+        out.push_back(static_cast<char>(payload.size()));
+        out.push_back(static_cast<char>(type));
+        out.push_back(static_cast<char>(flags));
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            out.push_back(static_cast<char>(streamId >> shift));
+        }
+        out.append(payload);
+    }
+
+    /* Preface and SETTINGS, then a GET for `path` on stream 1 unless the request came with an upgrade */
+    std::string clientStart(const std::string& path, bool withRequest)
+    {
+        std::string out(Http2Session::Preface);
+        writeFrame(out, 0x4, 0, 0, {});
+        if (withRequest)
+        {
+            HpackEncoder encoder;
+            std::string block;
+            encoder.encode(":method", "GET", block);
+            encoder.encode(":scheme", "http", block);
+            encoder.encode(":path", path, block);
+            encoder.encode(":authority", "x", block);
+            writeFrame(out, 0x1, 0x1 | 0x4, 1, block);
+        }
+        return out;
+    }
+
+    struct Answer
+    {
+        Fields headers;
+        std::string body;
+        bool complete = false;
+        uint32_t resetCode = 0;     /* Error code of an RST_STREAM, 0 without one */
+    };
+
+    /* Reads frames until stream 1 ends; `input` may already hold the first bytes */
+    Answer readStream1(int fd, std::string input)
+    {
+        Answer answer;
+        HpackDecoder decoder;
+        std::string block;
+        char buffer[65536];
+        pollfd readable{fd, POLLIN, 0};
+        while (!answer.complete)
+        {
+            while (input.size() >= 9)
+            {
+                size_t length = (static_cast<uint8_t>(input[0]) << 16) | (static_cast<uint8_t>(input[1]) << 8)
+                    | static_cast<uint8_t>(input[2]);
+                if (input.size() < 9 + length)
+                {
+                    break;
+                }
+                uint8_t type = static_cast<uint8_t>(input[3]);
+                uint8_t flags = static_cast<uint8_t>(input[4]);
+                uint32_t streamId = static_cast<uint8_t>(input[8]);
+                std::string_view payload = std::string_view(input).substr(9, length);
+                if (streamId == 1 && (type == 0x1 || type == 0x9))
+                {
+                    block.append(payload);
+                    if (flags & 0x4)
+                    {
+                        CHECK(decode(decoder, block, answer.headers));
+                    }
+                }
+                else if (streamId == 1 && type == 0x0)
+                {
+                    answer.body.append(payload);
+                }
+                else if (streamId == 1 && type == 0x3 && payload.size() == 4)
+                {
+                    answer.resetCode = (static_cast<uint8_t>(payload[0]) << 24) | (static_cast<uint8_t>(payload[1]) << 16)
+                        | (static_cast<uint8_t>(payload[2]) << 8) | static_cast<uint8_t>(payload[3]);
+                    answer.complete = true;
+                }
+                answer.complete = answer.complete || (streamId == 1 && (type == 0x0 || type == 0x1) && (flags & 0x1));
+                input.erase(0, 9 + length);
+            }
+            if (answer.complete || poll(&readable, 1, 5000) <= 0)
+            {
+                break;
+            }
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            input.append(buffer, received);
+        }
+        return answer;
+    }
+
+    bool hasField(const Fields& fields, std::string_view name, std::string_view value)
+    {
+        for (const auto& field : fields)
+        {
+            if (field.first == name && field.second == value)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Sends `fields` as-is on stream 1, then `body` as DATA unless it is empty */
+    Answer exchangeFields(int port, const Fields& fields, std::string_view body = {})
+    {
+        HpackEncoder encoder;
+        std::string block;
+        for (const auto& [name, value] : fields)
+        {
+            encoder.encode(name, value, block);
+        }
+        std::string request = clientStart({}, false);
+        writeFrame(request, 0x1, (body.empty() ? 0x1 : 0x0) | 0x4, 1, block);
+        if (!body.empty())
+        {
+            writeFrame(request, 0x0, 0x1, 1, body);
+        }
+
+        int fd = connectTo(port);
+        send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        Answer answer = readStream1(fd, {});
+        close(fd);
+        return answer;
+    }
+
+    Fields requestTo(std::string_view method, std::string_view path, const Fields& extra = {})
+    {
+        Fields fields = {{":method", std::string(method)}, {":scheme", "http"}, {":path", std::string(path)}, {":authority", "x"}};
+        fields.insert(fields.end(), extra.begin(), extra.end());
+        return fields;
+    }
+
+    /* Field values that would add fields or a second request line if they were turned into HTTP/1 text */
+    void checkMalformedFields(int port)
+    {
+        const std::vector<Fields> malformed = {
+            requestTo("GET", "/hello HTTP/1.1\r\nx-injected: 1"),
+            requestTo("GET", "/hello x"),
+            requestTo("GET", "hello"),
+            requestTo("GET", ""),
+            requestTo("GET", "/hello", {{"x-note", "a\r\nx-injected: 1"}}),
+            requestTo("GET", "/hello", {{"x-note", std::string("a\0b", 3)}}),
+            requestTo("GET", "/hello", {{"X-Note", "a"}}),
+            requestTo("GET", "/hello", {{"x note", "a"}}),
+            requestTo("GET", "/hello", {{"x-note:", "a"}}),
+            requestTo("GET /hello", "/hello"),
+            requestTo("GET", "/hello", {{":path", "/other"}}),
+            requestTo("GET", "/hello", {{"connection", "keep-alive"}}),
+            requestTo("GET", "/hello", {{"transfer-encoding", "chunked"}}),
+            requestTo("GET", "/hello", {{"keep-alive", "timeout=5"}}),
+            requestTo("GET", "/hello", {{"proxy-connection", "keep-alive"}}),
+            requestTo("GET", "/hello", {{"upgrade", "websocket"}}),
+            requestTo("GET", "/hello", {{"te", "gzip"}}),
+        };
+        for (const Fields& fields : malformed)
+        {
+            Answer answer = exchangeFields(port, fields);
+            CHECK(answer.complete && answer.resetCode == 0x1);
+            CHECK(answer.headers.empty());
+        }
+
+        Answer answer = exchangeFields(port, requestTo("GET", "/hello", {{"x-note", "a\tb"}, {"te", "trailers"}}));
+        CHECK(hasField(answer.headers, ":status", "200") && answer.body == "hello over h2");
+    }
+
+    /* Content-Length must parse and agree with the DATA that follows */
+    void checkContentLength(int port)
+    {
+        for (std::string_view length : {"abc", "12x", "", "-1", "99999999999999999999999"})
+        {
+            Answer answer = exchangeFields(port, requestTo("POST", "/echo", {{"content-length", std::string(length)}}), "abc");
+            CHECK(answer.complete && answer.resetCode == 0x1);
+        }
+
+        Answer answer = exchangeFields(port, requestTo("POST", "/echo", {{"content-length", "3"}, {"content-length", "3"}}), "abc");
+        CHECK(answer.complete && answer.resetCode == 0x1);
+
+        for (std::string_view length : {"2", "4", "0"})
+        {
+            answer = exchangeFields(port, requestTo("POST", "/echo", {{"content-length", std::string(length)}}), "abc");
+            CHECK(answer.complete && answer.resetCode == 0x1 && answer.headers.empty());
+        }
+        answer = exchangeFields(port, requestTo("POST", "/echo", {{"content-length", "5"}}));
+        CHECK(answer.complete && answer.resetCode == 0x1 && answer.headers.empty());
+
+        answer = exchangeFields(port, requestTo("POST", "/echo", {{"content-length", "3"}}), "abc");
+        CHECK(hasField(answer.headers, ":status", "200") && answer.body == "abc");
+        answer = exchangeFields(port, requestTo("POST", "/echo"), "abcd");
+        CHECK(hasField(answer.headers, ":status", "200") && answer.body == "abcd");
+    }
+
+    void checkPriorKnowledge(int port)
+    {
+        int fd = connectTo(port);
+        std::string request = clientStart("/hello", true);
+        send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        Answer answer = readStream1(fd, {});
+        close(fd);
+        CHECK(answer.complete);
+        CHECK(hasField(answer.headers, ":status", "200"));
+        CHECK(answer.body == "hello over h2");
+    }
+
+    /* The 101 and our preface, then the upgraded request is answered on stream 1 */
+    void checkUpgrade(int port, std::string_view upgrade)
+    {
+        int fd = connectTo(port);
+        std::string request = "GET /hello HTTP/1.1\r\nHost: x\r\nConnection: Upgrade, HTTP2-Settings\r\nUpgrade: "
+            + std::string(upgrade) + "\r\nHTTP2-Settings: AAMAAABk\r\n\r\n" + clientStart("/hello", false);
+        send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+        std::string input;
+        char buffer[65536];
+        pollfd readable{fd, POLLIN, 0};
+        while (input.find("\r\n\r\n") == std::string::npos && poll(&readable, 1, 5000) > 0)
+        {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            input.append(buffer, received);
+        }
+        size_t headEnd = input.find("\r\n\r\n");
+        CHECK(input.starts_with("HTTP/1.1 101 Switching Protocols\r\n"));
+        Answer answer = readStream1(fd, headEnd == std::string::npos ? std::string() : input.substr(headEnd + 4));
+        close(fd);
+        CHECK(answer.complete);
+        CHECK(hasField(answer.headers, ":status", "200"));
+        CHECK(answer.body == "hello over h2");
+    }
+
+    /* Requests that don't ask for h2c properly are answered over HTTP/1.1 */
+    void checkNoUpgrade(int port, std::string_view connection, std::string_view upgrade)
+    {
+        std::string response = roundTrip(port, "GET /hello HTTP/1.1\r\nHost: x\r\nConnection: " + std::string(connection)
+            + "\r\nUpgrade: " + std::string(upgrade) + "\r\nHTTP2-Settings: AAMAAABk\r\n\r\n"
+            "GET /hello HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+        CHECK(response.starts_with("HTTP/1.1 200 OK\r\n"));
+        CHECK(response.find("HTTP/1.1 200 OK\r\n", 1) != std::string::npos);
+        CHECK(response.ends_with("hello over h2"));
+    }
+}
+
+int
+main()
+{
+    checkRequestVectors("828684410f7777772e6578616d706c652e636f6d",
+                        "828684be58086e6f2d6361636865",
+                        "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565");
+    checkRequestVectors("828684418cf1e3c2e5f23a6ba0ab90f4ff",
+                        "828684be5886a8eb10649cbf",
+                        "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf");
+
+    /* A table size update is only allowed before the first field of a block */
+    HpackDecoder decoder;
+    Fields fields;
+    CHECK(decode(decoder, fromHex("3f0082"), fields));
+    CHECK(!decode(decoder, fromHex("823f00"), fields));
+
+    checkEncoderRoundTrip();
+
+    App app(2);
+    app.get("/hello", [](const Request&, Response& res) { res.send("hello over h2"); });
+    app.post("/echo", [](const Request& req, Response& res) { res.send(std::string(req.body)); });
+    startServer(app, 18107);
+
+    checkPriorKnowledge(18107);
+    checkUpgrade(18107, "h2c");
+    checkUpgrade(18107, "websocket, H2C");
+    checkNoUpgrade(18107, "Upgrade, HTTP2-Settings", "h2cfoo");
+    checkNoUpgrade(18107, "Upgrade", "h2c");
+    checkMalformedFields(18107);
+    checkContentLength(18107);
+    return finish();
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <memory_resource>
+#include "TestClient.h"
+#include "Core/Json.h"
+
+namespace
+{
+    const JsonValue* parse(std::string_view text, std::pmr::monotonic_buffer_resource& arena)
+    {
+        return parseJson(text, &arena);
+    }
+
+    bool accepts(std::string_view text)
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        return parse(text, arena) != nullptr;
+    }
+
+    void expectAccepted(std::string_view text)
+    {
+        if (!accepts(text))
+        {
+            std::fprintf(stderr, "rejected: %.*s\n", static_cast<int>(std::min<size_t>(text.size(), 80)), text.data());
+            CHECK(false);
+        }
+    }
+
+    void expectRejected(std::string_view text)
+    {
+        if (accepts(text))
+        {
+            std::fprintf(stderr, "accepted: %.*s\n", static_cast<int>(std::min<size_t>(text.size(), 80)), text.data());
+            CHECK(false);
+        }
+    }
+
+    std::string nested(size_t depth)
+    {
+        return std::string(depth, '[') + std::string(depth, ']');
+    }
+
+    void checkCorpus()
+    {
+        for (std::string_view text : {"0", "-0", "-0.0e+0", "1.5E-3", "123456789012345678901234567890", "true", "false",
+                                      "null", "\"\"", "[]", "{}", " \t\r\n[ 1 , {\"a\" : [null]} ] \n",
+                                      "\"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\"", "\"\\ud83d\\ude00\"", "\"\xe2\x82\xac\""})
+        {
+            expectAccepted(text);
+        }
+
+        for (std::string_view text : std::initializer_list<std::string_view>{
+                 "", " ", "01", "-01", "00", "1.", "-", "+1", ".5", "1e", "1e+", "0x10", "NaN", "Infinity",
+                 "[1,]", "{\"a\":1,}", "[,1]", "{,}", "[1 2]", "{\"a\" 1}", "{\"a\":}", "{1:2}", "{'a':1}",
+                 "\"\\ud800\"", "\"\\udc00\"", "\"\\ud800\\u0041\"", "\"\\ud800x\"", "\"\\u12\"", "\"\\x41\"", "\"\\\"",
+                 "\"a\tb\"", "\"a\nb\"", std::string_view("\"a\0b\"", 5), "\"\x1f\"",
+                 "1 2", "[] []", "{}x", "nullx", "truefalse", "[1]]", "\"a\"\"", "tru", "[", "{\"a\":[}"})
+        {
+            expectRejected(text);
+        }
+    }
+
+    /* Escapes and quotes that straddle the 64-byte blocks the first pass classifies */
+    void checkBlockBoundaries()
+    {
+        for (size_t pad = 0; pad < 140; ++pad)
+        {
+            std::string text = "[\"" + std::string(pad, 'a') + "\\\\\\\"\\u00e9\\ud83d\\ude00\\n" + "\",\""
+                + std::string(pad % 7, '\\') + std::string(pad % 7 % 2, '\\') + "\"]";
+            std::pmr::monotonic_buffer_resource arena;
+            const JsonValue* root = parse(text, arena);
+            CHECK(root && root->size() == 2);
+            if (root && root->size() == 2)
+            {
+                CHECK((*root)[0].asString() == std::string(pad, 'a') + "\\\"\xc3\xa9\xf0\x9f\x98\x80\n");
+                CHECK((*root)[1].asString() == std::string((pad % 7 + pad % 7 % 2) / 2, '\\'));
+            }
+
+            /* An odd run of backslashes escapes the quote, so the string never ends */
+            expectRejected("[\"" + std::string(pad, 'a') + std::string(2 * (pad % 5) + 1, '\\') + "\"]");
+        }
+    }
+
+    void checkDepth()
+    {
+        expectAccepted(nested(1024));
+        expectRejected(nested(1025));
+        expectRejected(nested(100000));
+
+        std::string objects;
+        for (size_t i = 0; i < 1024; ++i)
+        {
+            objects += "{\"a\":";
+        }
+        expectAccepted(objects + "1" + std::string(1024, '}'));
+    }
+
+    void checkValues()
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        const JsonValue* root = parse("{\"n\":-12.5e1,\"i\":42,\"s\":\"x\\u0041y\",\"b\":true,\"a\":[1,\"two\",null]}", arena);
+        CHECK(root && root->isObject() && root->size() == 5);
+        if (root)
+        {
+            CHECK((*root)["n"].asDouble() == -125.0);
+            CHECK((*root)["i"].asInt() == 42);
+            CHECK((*root)["s"].asString() == "xAy");
+            CHECK((*root)["b"].asBool());
+            CHECK((*root)["a"].size() == 3 && (*root)["a"][1].asString() == "two" && (*root)["a"][2].isNull());
+            CHECK(root->find("missing") == nullptr);
+        }
+    }
+}
+
+int
+main()
+{
+    checkCorpus();
+    checkBlockBoundaries();
+    checkDepth();
+    checkValues();
+    return finish();
+}
@@ -0,0 +1,186 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "TestClient.h"
+#include "Core/Multipart.h"
+
+namespace
+{
+    constexpr std::string_view BOUNDARY = "XyZ--b0undary";
+
+    /* Data near the delimiter: partial matches, a CR at the end of a piece, and a boundary without its CRLF */
+    const std::string FILE_DATA = std::string("line one\r\n--XyZ--b0undar\r\r\n-\r\n--XyZ-") + '\0' + "--XyZ--b0undary\r\n";
+
+    const std::string BODY = std::string("preamble to ignore\r\n")
+        + "--XyZ--b0undary\r\n"
+          "Content-Disposition: form-data; name=\"title\"\r\n"
+          "\r\n"
+          "Hello\r\n"
+          "--XyZ--b0undary  \r\n"
+          "content-disposition: form-data; name=\"upload\"; filename=\"a \\\"b\\\".txt\"\r\n"
+          "Content-Type: application/octet-stream\r\n"
+          "\r\n"
+        + FILE_DATA
+        + "\r\n--XyZ--b0undary\r\n"
+          "Content-Disposition: form-data; name=\"empty\"\r\n"
+          "\r\n"
+          "\r\n--XyZ--b0undary--\r\n"
+          "epilogue to ignore\r\n";
+
+    const std::string EXPECTED = "begin title||\ndata Hello\nend title\n"
+        "begin upload|a \"b\".txt|application/octet-stream\ndata " + FILE_DATA + "\nend upload\n"
+        "begin empty||\nend empty\n";
+
+    /* Everything the parser reports, with consecutive data pieces of a part joined */
+    struct Recorder
+    {
+        std::string log;
+        bool inData = false;
+
+        void attach(MultipartParser& parser)
+        {
+            parser.onPartBegin([this](const MultipartPart& part)
+            {
+                log += "begin " + part.name + "|" + part.filename + "|" + part.contentType + "\n";
+            });
+            parser.onPartData([this](const MultipartPart&, std::string_view data)
+            {
+                if (!inData)
+                {
+                    log += "data ";
+                    inData = true;
+                }
+                log.append(data);
+            });
+            parser.onPartEnd([this](const MultipartPart& part)
+            {
+                if (inData)
+                {
+                    log += "\n";
+                    inData = false;
+                }
+                log += "end " + part.name + "\n";
+            });
+        }
+    };
+
+    /* The body cut at every pair of offsets into three pieces */
+    void checkEverySplit()
+    {
+        for (size_t first = 0; first <= BODY.size(); ++first)
+        {
+            for (size_t second = first; second <= BODY.size(); ++second)
+            {
+                MultipartParser parser(BOUNDARY);
+                Recorder recorder;
+                recorder.attach(parser);
+                bool fed = parser.feed(std::string_view(BODY).substr(0, first))
+                    && parser.feed(std::string_view(BODY).substr(first, second - first))
+                    && parser.feed(std::string_view(BODY).substr(second));
+                if (!fed || !parser.done() || recorder.log != EXPECTED)
+                {
+                    std::fprintf(stderr, "split at %zu and %zu\n", first, second);
+                    CHECK(false);
+                    return;
+                }
+            }
+        }
+    }
+
+    bool parses(const std::string& body)
+    {
+        MultipartParser parser(BOUNDARY);
+        return parser.feed(body) && parser.done();
+    }
+
+    std::string partWithHeaders(const std::string& headers)
+    {
+        return "--XyZ--b0undary\r\n" + headers + "\r\nvalue\r\n--XyZ--b0undary--\r\n";
+    }
+
+    void checkMalformed()
+    {
+        std::string disposition = "Content-Disposition: form-data; name=\"field\"\r\n";
+        CHECK(parses(partWithHeaders(disposition)));
+
+        /* A header block over the limit, whether or not its end has arrived */
+        std::string padding = "X-Padding: " + std::string(MultipartParser::MaxHeaderSize - 200, 'p') + "\r\n";
+        CHECK(parses(partWithHeaders(disposition + padding)));
+        std::string tooLarge = "X-Padding: " + std::string(MultipartParser::MaxHeaderSize, 'p') + "\r\n";
+        CHECK(!parses(partWithHeaders(disposition + tooLarge)));
+        MultipartParser endless(BOUNDARY);
+        CHECK(!endless.feed("--XyZ--b0undary\r\n" + tooLarge + tooLarge));
+        CHECK(endless.failed());
+
+        /* Every part must say what it is */
+        CHECK(!parses(partWithHeaders("Content-Type: text/plain\r\n")));
+        CHECK(!parses(partWithHeaders("")));
+        CHECK(!parses(partWithHeaders(disposition + "no colon here\r\n")));
+
+        /* Junk after a delimiter, and a body that just stops */
+        CHECK(!parses("--XyZ--b0undary junk\r\n" + disposition + "\r\nvalue\r\n--XyZ--b0undary--"));
+        CHECK(!parses("--XyZ--b0undary\r\n" + disposition + "\r\nvalue"));
+
+        MultipartParser noBoundary("");
+        CHECK(noBoundary.failed());
+        CHECK(MultipartParser::boundaryOf("multipart/form-data; charset=utf-8; boundary=\"XyZ--b0undary\"") == BOUNDARY);
+        CHECK(MultipartParser::boundaryOf("multipart/form-data").empty());
+    }
+
+    void checkForm()
+    {
+        char directory[] = "/tmp/multipart-test-XXXXXX";
+        CHECK(mkdtemp(directory) != nullptr);
+
+        std::string path;
+        {
+            MultipartForm form("multipart/form-data; boundary=XyZ--b0undary", directory);
+            CHECK(form.feed(BODY));
+            CHECK(form.done());
+            CHECK(form.field("title") == "Hello");
+            CHECK(form.fields.count("empty") == 1 && form.field("empty").empty());
+            CHECK(form.files.size() == 1);
+            if (form.files.size() == 1)
+            {
+                path = form.files[0].path;
+                CHECK(form.files[0].size == FILE_DATA.size());
+                std::ifstream file(path, std::ios::binary);
+                std::stringstream contents;
+                contents << file.rdbuf();
+                CHECK(contents.str() == FILE_DATA);
+            }
+        }
+        unlink(path.c_str());
+
+        /* An incomplete form deletes what it stored */
+        {
+            MultipartForm form("multipart/form-data; boundary=XyZ--b0undary", directory);
+            CHECK(form.feed(BODY.substr(0, BODY.find("\r\n--XyZ--b0undary\r\nContent-Disposition: form-data; name=\"empty\""))));
+            CHECK(!form.done() && form.files.size() == 1);
+            if (form.files.size() == 1)
+            {
+                path = form.files[0].path;
+            }
+        }
+        CHECK(access(path.c_str(), F_OK) != 0);
+
+        /* Fields past the limit fail the form */
+        MultipartForm large("multipart/form-data; boundary=XyZ--b0undary", directory);
+        CHECK(!large.feed("--XyZ--b0undary\r\nContent-Disposition: form-data; name=\"big\"\r\n\r\n"
+            + std::string(MultipartForm::MaxFieldBytes + 1, 'v')));
+        CHECK(!large.done());
+
+        MultipartForm noBoundary("multipart/form-data", directory);
+        CHECK(!noBoundary.feed(BODY) && !noBoundary.done());
+        rmdir(directory);
+    }
+}
+
+int
+main()
+{
+    checkEverySplit();
+    checkMalformed();
+    checkForm();
+    return finish();
+}
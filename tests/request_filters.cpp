@@ -0,0 +1,37 @@
+#include <stdexcept>
+#include "TestClient.h"
+
+int
+main()
+{
+    App app(2);
+    app.use([](const Request& req)
+    {
+        if (req.path == "/throw")
+        {
+            throw std::runtime_error("filter failed");
+        }
+        return req.path == "/busy" ? 503 : 0;
+    });
+    app.get("/throw", [](const Request&, Response& res) { res.send("not reached"); });
+    app.get("/busy", [](const Request&, Response& res) { res.send("not reached"); });
+    app.get("/ok", [](const Request&, Response& res) { res.send("fine"); });
+    startServer(app, 18104);
+
+    /* A throwing filter refuses its request with a 500 and the connection carries on */
+    std::string response = roundTrip(18104,
+        "GET /throw HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /ok HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    CHECK(response.starts_with("HTTP/1.1 500 Internal Server Error\r\n"));
+    CHECK(response.find("not reached") == std::string::npos);
+    CHECK(response.ends_with("fine"));
+
+    /* Refusals carry the status's own reason phrase */
+    response = roundTrip(18104, "GET /busy HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    CHECK(response.starts_with("HTTP/1.1 503 Service Unavailable\r\n"));
+    CHECK(response.ends_with("\r\n\r\nService Unavailable"));
+
+    /* The server survived */
+    CHECK(roundTrip(18104, "GET /ok HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n").ends_with("fine"));
+    return finish();
+}
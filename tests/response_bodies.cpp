@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <cstring>
+#include <memory_resource>
+#include "TestClient.h"
+
+namespace
+{
+    std::string get(int port, const std::string& path)
+    {
+        return roundTrip(port, "GET " + path + " HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    }
+}
+
+int
+main()
+{
+    App app(2);
+
+    /* Each handler clobbers what it sent before returning, so a body kept by reference shows it */
+    app.get("/stack", [](const Request&, Response& res)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "count=%d", 42);
+        res.send(buffer);
+        std::memset(buffer, 'X', sizeof(buffer) - 1);
+    });
+    app.get("/large", [](const Request&, Response& res)
+    {
+        char buffer[4096];
+        std::memset(buffer, 'a', sizeof(buffer));
+        res.send(std::string_view(buffer, sizeof(buffer)));
+        std::memset(buffer, 'X', sizeof(buffer));
+    });
+    app.get("/c_str", [](const Request&, Response& res)
+    {
+        std::string text = "heap body";
+        res.json(text.c_str());
+        text.assign("XXXXXXXXX");
+    });
+    app.get("/pmr", [](const Request&, Response& res)
+    {
+        std::pmr::string text("pmr body");
+        res.send(text);
+        text.assign("XXXXXXXX");
+    });
+    app.get("/static", [](const Request&, Response& res) { res.sendStatic("static body"); });
+    startServer(app, 18103);
+
+    CHECK(get(18103, "/stack").ends_with("\r\n\r\ncount=42"));
+    CHECK(get(18103, "/large").ends_with("\r\n\r\n" + std::string(4096, 'a')));
+    std::string json = get(18103, "/c_str");
+    CHECK(json.find("Content-Type: application/json\r\n") != std::string::npos);
+    CHECK(json.ends_with("\r\n\r\nheap body"));
+    CHECK(get(18103, "/pmr").ends_with("\r\n\r\npmr body"));
+    CHECK(get(18103, "/static").ends_with("\r\n\r\nstatic body"));
+    return finish();
+}
@@ -0,0 +1,39 @@
+#include "TestClient.h"
+
+namespace
+{
+    constexpr std::string_view BAD_REQUEST = "HTTP/1.1 400 Bad Request\r\n";
+}
+
+int
+main()
+{
+    App app(2);
+    app.get("/", [](const Request&, Response& res) { res.send("fine"); });
+    app.post("/echo", [](const Request& req, Response& res) { res.send(std::string(req.body)); });
+    startServer(app, 18106);
+
+    CHECK(roundTrip(18106, "GET / HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n").ends_with("fine"));
+
+    /* A request names one host: missing, repeated or listed hosts are all refused */
+    CHECK(roundTrip(18106, "GET / HTTP/1.1\r\nConnection: close\r\n\r\n").starts_with(BAD_REQUEST));
+    CHECK(roundTrip(18106, "GET / HTTP/1.1\r\nHost: x\r\nHost: y\r\nConnection: close\r\n\r\n").starts_with(BAD_REQUEST));
+    CHECK(roundTrip(18106, "GET / HTTP/1.1\r\nHost: x\r\nhost: x\r\nConnection: close\r\n\r\n").starts_with(BAD_REQUEST));
+    CHECK(roundTrip(18106, "GET / HTTP/1.1\r\nHost: x, y\r\nConnection: close\r\n\r\n").starts_with(BAD_REQUEST));
+    CHECK(roundTrip(18106, "GET / HTTP/1.0\r\nHost: x\r\nHost: y\r\n\r\n").starts_with(BAD_REQUEST));
+
+    /* The same goes for the other fields that frame the request */
+    CHECK(roundTrip(18106, "POST / HTTP/1.1\r\nHost: x\r\nContent-Length: 1\r\nContent-Length: 1\r\n\r\na")
+              .starts_with(BAD_REQUEST));
+    CHECK(roundTrip(18106, "POST / HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\nContent-Length: 1\r\n\r\n0\r\n\r\n")
+              .starts_with(BAD_REQUEST));
+
+    /* Chunk data ends with exactly CRLF */
+    std::string chunked = "POST /echo HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n3\r\nabc";
+    CHECK(roundTrip(18106, chunked + "\r\n0\r\n\r\n").ends_with("abc"));
+    for (std::string_view end : {"\n", "\r\r\n", "\r", "x\r\n", "\rx"})
+    {
+        CHECK(roundTrip(18106, chunked + std::string(end) + "0\r\n\r\n").starts_with(BAD_REQUEST));
+    }
+    return finish();
+}
@@ -0,0 +1,209 @@
+#include <memory>
+#include "TestClient.h"
+#include "Core/WebSocket.h"
+
+namespace
+{
+    constexpr uint8_t MASK[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+    /* A client frame; clients mask unless told not to */
+    std::string clientFrame(uint8_t opcode, std::string_view payload, bool fin = true, bool masked = true)
+    {
+        std::string bytes = WebSocket::frame(opcode, payload);
+        size_t headerSize = bytes.size() - payload.size();
+        if (!fin)
+        {
+            bytes[0] = static_cast<char>(bytes[0] & 0x7F);
+        }
+        if (!masked)
+        {
+            return bytes;
+        }
+        bytes[1] = static_cast<char>(bytes[1] | 0x80);
+        bytes.insert(headerSize, reinterpret_cast<const char*>(MASK), 4);
+        WebSocket::unmask(payload.data(), bytes.data() + headerSize + 4, payload.size(), MASK, 0);
+        return bytes;
+    }
+
+    std::shared_ptr<WebSocket> makeSocket(size_t maxMessageSize = 1024)
+    {
+        return std::make_shared<WebSocket>(Priority::Normal, maxMessageSize, 1024 * 1024,
+                                           [](std::shared_ptr<WebSocket>, std::string) {});
+    }
+
+    /* Feeds `input` as the connection would: unconsumed bytes are offered again with the next read */
+    std::string receiveInPieces(WebSocket& socket, std::string_view input, size_t split)
+    {
+        std::string replies;
+        std::string buffered(input.substr(0, split));
+        buffered.erase(0, socket.receive(buffered, replies));
+        buffered.append(input.substr(split));
+        buffered.erase(0, socket.receive(buffered, replies));
+        CHECK(buffered.empty());
+        return replies;
+    }
+
+    /* Code of the close frame the server answered with */
+    uint16_t closeCode(std::string_view replies)
+    {
+        if (replies.size() < 4 || static_cast<uint8_t>(replies[0]) != 0x88)
+        {
+            return 0;
+        }
+        return static_cast<uint16_t>((static_cast<uint8_t>(replies[2]) << 8) | static_cast<uint8_t>(replies[3]));
+    }
+
+    void checkSplitFrames()
+    {
+        /* Short and 16-bit lengths, each cut at every byte so headers, masks and payloads straddle reads */
+        for (size_t size : {40, 300})
+        {
+            std::string payload;
+            for (size_t i = 0; i < size; ++i)
+            {
+                payload.push_back(static_cast<char>('a' + i % 26));
+            }
+            std::string bytes = clientFrame(WebSocket::Text, payload);
+            for (size_t split = 0; split <= bytes.size(); ++split)
+            {
+                auto socket = makeSocket();
+                CHECK(receiveInPieces(*socket, bytes, split).empty());
+                CHECK(socket->inbox.size() == 1 && socket->inbox[0].data == payload && !socket->inbox[0].binary);
+            }
+        }
+
+        /* A fragmented message may have a ping between its fragments, and a character split across them */
+        auto socket = makeSocket();
+        std::string bytes = clientFrame(WebSocket::Text, "price: \xe2\x82", false) + clientFrame(WebSocket::Ping, "p")
+            + clientFrame(WebSocket::Continuation, "\xac" "5");
+        std::string replies = receiveInPieces(*socket, bytes, 5);
+        CHECK(replies == WebSocket::frame(WebSocket::Pong, "p"));
+        CHECK(socket->inbox.size() == 1 && socket->inbox[0].data == "price: \xe2\x82\xac" "5");
+    }
+
+    void checkFailures()
+    {
+        /* Invalid UTF-8 only shows once the fragments are put together */
+        auto socket = makeSocket();
+        std::string replies;
+        std::string bytes = clientFrame(WebSocket::Text, "abc\xe2\x82", false) + clientFrame(WebSocket::Continuation, "(");
+        socket->receive(bytes, replies);
+        CHECK(closeCode(replies) == WebSocket::InvalidData);
+        CHECK(socket->inbox.empty() && !socket->isOpen());
+
+        socket = makeSocket();
+        replies.clear();
+        socket->receive(clientFrame(WebSocket::Text, "hello", true, false), replies);
+        CHECK(closeCode(replies) == WebSocket::ProtocolError);
+        CHECK(socket->inbox.empty());
+
+        /* Too big as one frame, and as fragments that are each small enough */
+        socket = makeSocket(64);
+        replies.clear();
+        socket->receive(clientFrame(WebSocket::Binary, std::string(65, 'x')), replies);
+        CHECK(closeCode(replies) == WebSocket::MessageTooBig);
+
+        socket = makeSocket(64);
+        replies.clear();
+        socket->receive(clientFrame(WebSocket::Binary, std::string(40, 'x'), false)
+                        + clientFrame(WebSocket::Continuation, std::string(40, 'x')), replies);
+        CHECK(closeCode(replies) == WebSocket::MessageTooBig);
+        CHECK(socket->inbox.empty());
+
+        /* Nothing is read once the close is out */
+        socket = makeSocket();
+        replies.clear();
+        bytes = clientFrame(WebSocket::Text, "x", true, false) + clientFrame(WebSocket::Text, "after");
+        CHECK(socket->receive(bytes, replies) < bytes.size());
+        CHECK(socket->inbox.empty());
+    }
+
+    void checkCloseEcho()
+    {
+        /* The code is echoed without the reason, and the socket stops reading */
+        auto socket = makeSocket();
+        std::string replies;
+        std::string bytes = clientFrame(WebSocket::Close, std::string("\x03\xe8", 2) + "bye");
+        std::string after = clientFrame(WebSocket::Text, "ignored");
+        CHECK(socket->receive(bytes + after, replies) == bytes.size());
+        CHECK(replies == WebSocket::frame(WebSocket::Close, std::string("\x03\xe8", 2)));
+        CHECK(socket->closeCode == WebSocket::Normal && socket->closeReason == "bye");
+        CHECK(socket->inbox.empty() && !socket->isOpen());
+
+        /* An empty close is answered with an empty one */
+        socket = makeSocket();
+        replies.clear();
+        socket->receive(clientFrame(WebSocket::Close, {}), replies);
+        CHECK(replies == WebSocket::frame(WebSocket::Close, {}));
+        CHECK(socket->closeCode == WebSocket::NoStatus);
+
+        /* Codes that must not be sent on the wire, and a reason that is not UTF-8 */
+        socket = makeSocket();
+        replies.clear();
+        socket->receive(clientFrame(WebSocket::Close, std::string("\x03\xed", 2)), replies);
+        CHECK(closeCode(replies) == WebSocket::ProtocolError);
+
+        socket = makeSocket();
+        replies.clear();
+        socket->receive(clientFrame(WebSocket::Close, std::string("\x03\xe8\xff", 3)), replies);
+        CHECK(closeCode(replies) == WebSocket::InvalidData);
+    }
+
+    /* Handshake, an echoed message and the close handshake over a real connection */
+    void checkEndToEnd(int port)
+    {
+        int fd = connectTo(port);
+        std::string request = "GET /echo HTTP/1.1\r\nHost: x\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n"
+            + clientFrame(WebSocket::Text, "hi") + clientFrame(WebSocket::Close, std::string("\x03\xe8", 2));
+        send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+        std::string response;
+        char buffer[4096];
+        pollfd readable{fd, POLLIN, 0};
+        while (poll(&readable, 1, 5000) > 0)
+        {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            response.append(buffer, received);
+        }
+        close(fd);
+
+        std::string head = "HTTP/1.1 101 Switching Protocols\r\n";
+        CHECK(response.starts_with(head));
+        CHECK(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+        size_t headEnd = response.find("\r\n\r\n");
+        std::string frames = headEnd == std::string::npos ? std::string() : response.substr(headEnd + 4);
+        std::string echo = WebSocket::frame(WebSocket::Text, "hi");
+        std::string closing = WebSocket::frame(WebSocket::Close, std::string("\x03\xe8", 2));
+        /* The echo is sent from a worker, so it may miss the close reply and be dropped */
+        CHECK(frames == echo + closing || frames == closing);
+    }
+}
+
+int
+main()
+{
+    checkSplitFrames();
+    checkFailures();
+    checkCloseEcho();
+
+    App app(2);
+    app.ws("/echo", [](std::shared_ptr<WebSocket> socket, const Request&)
+    {
+        std::weak_ptr<WebSocket> weak = socket;
+        socket->onMessage = [weak](std::string_view message, bool binary)
+        {
+            if (auto socket = weak.lock())
+            {
+                socket->send(message, binary);
+            }
+        };
+    });
+    startServer(app, 18108);
+    checkEndToEnd(18108);
+    return finish();
+}